@@ -0,0 +1,75 @@
+//                              -*- Mode: C++ -*-
+// AdjacencyTable.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Apr 11 09:35:20 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <algorithm>
+
+#include "AdjacencyTable.h"
+
+
+
+namespace annotate
+{
+
+  const unsigned int AdjacencyTable::NONE;
+
+
+  void
+  AdjacencyTable::build (unsigned int nbVertices, vector< Edge > &edges)
+  {
+    unsigned int i;
+    unsigned int nbSlots;
+
+    clear ();
+    std::sort (edges.begin (), edges.end ());
+
+    offsets.resize (nbVertices + 1, 0);
+    neighbors.reserve (edges.size ());
+    relations.reserve (edges.size ());
+    for (i = 0; i < edges.size (); ++i)
+      {
+	++offsets[edges[i].from + 1];
+	neighbors.push_back (edges[i].to);
+	relations.push_back (edges[i].relation);
+      }
+    for (i = 0; i < nbVertices; ++i)
+      {
+	offsets[i + 1] += offsets[i];
+      }
+
+    // At most half full so that the probe sequences stay short.
+    for (nbSlots = 2, slotShift = 63; nbSlots < 2 * edges.size (); nbSlots <<= 1, --slotShift)
+      ;
+    slotKeys.resize (nbSlots);
+    slotEdges.resize (nbSlots, NONE);
+    for (i = 0; i < edges.size (); ++i)
+      {
+	uint64_t key = makeKey (edges[i].from, edges[i].to);
+	unsigned int slot;
+
+	for (slot = hash (key); NONE != slotEdges[slot]; slot = (slot + 1) & (nbSlots - 1))
+	  ;
+	slotKeys[slot] = key;
+	slotEdges[slot] = i;
+      }
+  }
+
+
+  void
+  AdjacencyTable::clear ()
+  {
+    offsets.clear ();
+    neighbors.clear ();
+    relations.clear ();
+    slotKeys.clear ();
+    slotEdges.clear ();
+    slotShift = 64;
+  }
+
+}
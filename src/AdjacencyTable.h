@@ -0,0 +1,217 @@
+//                              -*- Mode: C++ -*-
+// AdjacencyTable.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Apr 11 09:35:20 2011
+
+
+#ifndef _annotate_AdjacencyTable_h_
+#define _annotate_AdjacencyTable_h_
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "mccore/GraphModel.h"
+#include "mccore/Relation.h"
+
+using namespace mccore;
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Immutable compressed sparse row snapshot of an annotated graph.
+   *
+   * The neighbors of a vertex are stored contiguously, sorted by label, with
+   * their relations in a parallel array.  A hashed (label, label) index
+   * gives the edge between two vertices, and so its relation, in constant
+   * time.  The edge positions also index the per-edge arrays of the
+   * analysis passes.  The table is built once the relations are computed
+   * and is not updated afterwards.
+   */
+  class AdjacencyTable
+  {
+    /**
+     * The start of each vertex row, plus the end of the last one.
+     */
+    vector< unsigned int > offsets;
+
+    /**
+     * The neighbor labels, by row.
+     */
+    vector< GraphModel::label > neighbors;
+
+    /**
+     * The relations to the neighbors, parallel to neighbors.
+     */
+    vector< const Relation* > relations;
+
+    /**
+     * The open addressing index of the edges: the (label, label) key of
+     * each slot.
+     */
+    vector< uint64_t > slotKeys;
+
+    /**
+     * The edge position of each slot, NONE for a free slot.
+     */
+    vector< unsigned int > slotEdges;
+
+    /**
+     * The bit shift reducing a hash to a slot.
+     */
+    unsigned int slotShift;
+
+  public:
+
+    /**
+     * The position of a missing edge.
+     */
+    static const unsigned int NONE = 0xffffffff;
+
+    /**
+     * A directed edge to insert.
+     */
+    struct Edge
+    {
+      GraphModel::label from;
+      GraphModel::label to;
+      const Relation *relation;
+
+      bool operator< (const Edge &right) const
+      {
+	return from < right.from || (from == right.from && to < right.to);
+      }
+    };
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    AdjacencyTable () : slotShift (64) { }
+
+    ~AdjacencyTable () { }
+
+    // ACCESS ---------------------------------------------------------------
+
+    /**
+     * Gets the number of vertices.
+     */
+    unsigned int size () const { return offsets.empty () ? 0 : offsets.size () - 1; }
+
+    /**
+     * Gets the number of directed edges.
+     */
+    unsigned int edgeSize () const { return neighbors.size (); }
+
+    /**
+     * Gets the number of neighbors of a vertex.
+     */
+    unsigned int degree (GraphModel::label l) const { return offsets[l + 1] - offsets[l]; }
+
+    /**
+     * Gets the first neighbor of a vertex, the neighbors are sorted.
+     */
+    const GraphModel::label* neighborBegin (GraphModel::label l) const
+    {
+      return (neighbors.empty () ? 0 : &neighbors[0]) + offsets[l];
+    }
+
+    /**
+     * Gets the end of the neighbors of a vertex.
+     */
+    const GraphModel::label* neighborEnd (GraphModel::label l) const
+    {
+      return (neighbors.empty () ? 0 : &neighbors[0]) + offsets[l + 1];
+    }
+
+    /**
+     * Gets the relations to the neighbors of a vertex, parallel to
+     * neighborBegin.
+     */
+    const Relation* const* relationBegin (GraphModel::label l) const
+    {
+      return (relations.empty () ? 0 : &relations[0]) + offsets[l];
+    }
+
+    /**
+     * Finds the edge from one vertex to another.
+     * @param from the first vertex label.
+     * @param to the second vertex label.
+     * @return the edge position, below edgeSize, or NONE if the vertices
+     * are not connected.
+     */
+    unsigned int find (GraphModel::label from, GraphModel::label to) const
+    {
+      uint64_t key = makeKey (from, to);
+      unsigned int slot;
+
+      if (slotEdges.empty ())
+	{
+	  return NONE;
+	}
+      for (slot = hash (key); NONE != slotEdges[slot]; slot = (slot + 1) & (slotEdges.size () - 1))
+	{
+	  if (key == slotKeys[slot])
+	    {
+	      return slotEdges[slot];
+	    }
+	}
+      return NONE;
+    }
+
+    /**
+     * Gets the relation from one vertex to another.
+     * @param from the first vertex label.
+     * @param to the second vertex label.
+     * @return the relation, null if the vertices are not connected or the
+     * edge has no relation object.
+     */
+    const Relation* getRelation (GraphModel::label from, GraphModel::label to) const
+    {
+      unsigned int e = find (from, to);
+
+      return NONE == e ? 0 : relations[e];
+    }
+
+    /**
+     * Tells if two vertices are connected.
+     */
+    bool areConnected (GraphModel::label from, GraphModel::label to) const
+    {
+      return NONE != find (from, to);
+    }
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Builds the table.
+     * @param nbVertices the number of vertices.
+     * @param edges the directed edges, reordered by the call.
+     */
+    void build (unsigned int nbVertices, vector< Edge > &edges);
+
+    void clear ();
+
+  private:
+
+    static uint64_t makeKey (GraphModel::label from, GraphModel::label to)
+    {
+      return (uint64_t) (uint32_t) from << 32 | (uint32_t) to;
+    }
+
+    /**
+     * Hashes a key to a slot (Fibonacci hashing).
+     */
+    unsigned int hash (uint64_t key) const
+    {
+      return (unsigned int) ((key * 0x9e3779b97f4a7c15ULL) >> slotShift);
+    }
+
+  };
+
+}
+
+#endif
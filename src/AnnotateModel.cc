@@ -12,16 +12,22 @@
 #include <config.h>
 
 #include <algorithm>
+#include <cmath>
 #include <iterator>
 #include <list>
+#include <sstream>
 
 #include "mccore/Binstream.h"
+#include "mccore/Exception.h"
 #include "mccore/Messagestream.h"
 #include "mccore/Pdbstream.h"
 #include "mccore/UndirectedGraph.h"
 #include "mccore/stlio.h"
 
 #include "AnnotateModel.h"
+#include "NestedPairs.h"
+#include "RankTree.h"
+#include "TaskPool.h"
 
 
 
@@ -33,18 +39,55 @@ namespace annotate
   static const unsigned int LHELIX = 2;
   static const unsigned int RHELIX = 4;
 
+  /**
+   * The atom distance under which two residues are in contact, the same
+   * cutoff mccore uses to extract the residue pairs to annotate.
+   */
+  static const float CONTACT_CUTOFF = 5.0;
+
+
+  /**
+   * Tells if two residues have atoms closer than the contact cutoff.
+   */
+  static bool
+  inContact (const Residue &ref, const Residue &res)
+  {
+    Residue::const_iterator i;
+    Residue::const_iterator j;
+
+    for (i = ref.begin (); ref.end () != i; ++i)
+      {
+	for (j = res.begin (); res.end () != j; ++j)
+	  {
+	    if (i->distance (*j) <= CONTACT_CUTOFF)
+	      {
+		return true;
+	      }
+	  }
+      }
+    return false;
+  }
+
   
   AbstractModel* 
   AnnotateModelFM::createModel () const
   {
-    return new AnnotateModel (residueSelection, environment, rFM);
+    AnnotateModel *am = new AnnotateModel (residueSelection, environment, rFM);
+
+    am->setCellSize (cellSize);
+    am->setNbThreads (nbThreads);
+    return am;
   }
 
 
   AbstractModel*
   AnnotateModelFM::createModel (const AbstractModel &model) const
   {
-    return new AnnotateModel (model, residueSelection, environment, rFM);
+    AnnotateModel *am = new AnnotateModel (model, residueSelection, environment, rFM);
+
+    am->setCellSize (cellSize);
+    am->setNbThreads (nbThreads);
+    return am;
   }
   
 
@@ -55,6 +98,58 @@ namespace annotate
   }
 
 
+  /**
+   * Writes a property name to a snapshot.
+   */
+  static void
+  writeName (oBinstream &obs, const PropertyType *t)
+  {
+    ostringstream oss;
+    string name;
+    string::iterator it;
+
+    oss << t;
+    name = oss.str ();
+    obs << (unsigned int) name.size ();
+    for (it = name.begin (); name.end () != it; ++it)
+      {
+	obs << *it;
+      }
+  }
+
+
+  /**
+   * Reads a property name from a snapshot.
+   */
+  static string
+  readName (iBinstream &is)
+  {
+    string name;
+    unsigned int n = 0;
+    char c;
+
+    is >> n;
+    for (; 0 < n && is.good (); --n)
+      {
+	is >> c;
+	name.push_back (c);
+      }
+    return name;
+  }
+
+
+  const unsigned int AnnotateModel::SNAPSHOT_MAGIC;
+
+  const unsigned int AnnotateModel::SNAPSHOT_VERSION;
+
+
+  float
+  AnnotateModel::getContactCutoff ()
+  {
+    return CONTACT_CUTOFF;
+  }
+
+
   void
   AnnotateModel::annotate ()
   {
@@ -70,14 +165,22 @@ namespace annotate
 // //     singlestrands.clear ();
     marks.clear ();
 
-// //     GraphModel::annotate (residueSelection);
-    GraphModel::annotate ();
+    nbPairs = 0;
+    nbCandidates = 0;
+    if (residueSelection.empty ())
+      {
+	annotateAll ();
+      }
+    else
+      {
+	annotateSelection ();
+      }
     marks.resize (size (), 0);
+    freezeGraph ();
     fillSeqBPStacks ();
-    std::sort (basepairs.begin (), basepairs.end ());
-    std::sort (stacks.begin (), stacks.end ());
-    std::sort (links.begin (), links.end ());
-//     findHelices ();
+    findStructures ();
+    // mccore made its lazy first uses, see TaskPool.
+    TaskPool::setWarm ();
 // //     findLoops ();
 // //     findInternalLoops ();
 // //     findMultiLoops ();
@@ -86,227 +189,495 @@ namespace annotate
 
 
   void
-  AnnotateModel::fillSeqBPStacks ()
+  AnnotateModel::computeSpheres ()
   {
-    edge_iterator eit;
+    label l;
+
+    spheres.clear ();
+    spheres.reserve (size ());
+    for (l = 0; l < (label) size (); ++l)
+      {
+	const Residue *res = internalGetVertex (l);
+	Residue::const_iterator aIt;
+	float x = 0;
+	float y = 0;
+	float z = 0;
+	float radius = 0;
+	float n = 0;
+
+	for (aIt = res->begin (); res->end () != aIt; ++aIt, ++n)
+	  {
+	    x += aIt->getX ();
+	    y += aIt->getY ();
+	    z += aIt->getZ ();
+	  }
+	if (0 < n)
+	  {
+	    x /= n;
+	    y /= n;
+	    z /= n;
+	  }
+	for (aIt = res->begin (); res->end () != aIt; ++aIt)
+	  {
+	    float dx = aIt->getX () - x;
+	    float dy = aIt->getY () - y;
+	    float dz = aIt->getZ () - z;
+	    
+	    radius = std::max (radius, (float) sqrt (dx * dx + dy * dy + dz * dz));
+	  }
+	spheres.push_back (x, y, z, radius);
+      }
+  }
+
+  
+  void
+  AnnotateModel::annotateAll ()
+  {
+    ResidueGrid grid (CONTACT_CUTOFF, cellSize);
+    vector< pair< unsigned int, unsigned int > > candidates;
+    iterator it;
+
+    for (it = begin (); end () != it; ++it)
+      {
+	it->finalize ();
+      }
+    // finalize adds hydrogens, lone pairs and pseudo-atoms to the spheres.
+    computeSpheres ();
+    nbPairs = (unsigned long) size () * (size () - 1) / 2;
+    if (0 != neighborList)
+      {
+	const vector< pair< unsigned int, unsigned int > > &listed = neighborList->update (*this, spheres);
+
+	nbCandidates = listed.size ();
+	relatePairs (listed);
+      }
+    else
+      {
+	grid.build (spheres);
+	grid.candidates (candidates);
+	nbCandidates = candidates.size ();
+	relatePairs (candidates);
+      }
+  }
+
+  
+  void
+  AnnotateModel::annotateSelection ()
+  {
+    ResidueGrid grid (CONTACT_CUTOFF, cellSize);
+    vector< bool > done (size (), false);
+    vector< bool > queued (size (), false);
+    vector< label > frontier;
+    unsigned long nbDone = 0;
+    iterator it;
+    unsigned int layer;
+
+    for (it = begin (); end () != it; ++it)
+      {
+	it->finalize ();
+	if (residueSelection.end () != residueSelection.find (it->getResId ()))
+	  {
+	    label l = getVertexLabel (&*it);
+	    
+	    frontier.push_back (l);
+	    queued[l] = true;
+	  }
+      }
+    // finalize adds hydrogens, lone pairs and pseudo-atoms to the spheres.
+    computeSpheres ();
+    grid.build (spheres);
+    for (layer = 0; layer <= environment && ! frontier.empty (); ++layer)
+      {
+	vector< pair< unsigned int, unsigned int > > candidates;
+	vector< pair< unsigned int, unsigned int > >::iterator cIt;
+	vector< bool > related;
+	vector< label > next;
+	vector< label >::iterator fIt;
+	unsigned int i;
+
+	for (fIt = frontier.begin (); frontier.end () != fIt; ++fIt)
+	  {
+	    vector< unsigned int > nbors;
+	    vector< unsigned int >::iterator nIt;
+
+	    grid.neighbors (*fIt, nbors);
+	    std::sort (nbors.begin (), nbors.end ());
+	    nbPairs += size () - 1 - nbDone;
+	    for (nIt = nbors.begin (); nbors.end () != nIt; ++nIt)
+	      {
+		// Pairs with an already expanded residue were computed.
+		if (! done[*nIt])
+		  {
+		    candidates.push_back (make_pair (*fIt, *nIt));
+		  }
+	      }
+	    done[*fIt] = true;
+	    ++nbDone;
+	  }
+	nbCandidates += candidates.size ();
+	relatePairs (candidates, &related);
+	for (i = 0; i < candidates.size (); ++i)
+	  {
+	    if (related[i] && ! queued[candidates[i].second])
+	      {
+		next.push_back (candidates[i].second);
+		queued[candidates[i].second] = true;
+	      }
+	  }
+	frontier.swap (next);
+      }
+  }
+
+
+  /**
+   * Evaluates slices of the candidate residue pairs concurrently.  Each job
+   * only writes the relations of its own slice.
+   */
+  class RelationTask : public Task
+  {
+    const vector< const Residue* > &residues;
     
+    const vector< pair< unsigned int, unsigned int > > &pairs;
+
+    vector< Relation* > &relations;
+
+  public:
+
+    /**
+     * The number of pairs evaluated per job.
+     */
+    static const unsigned int SLICE = 256;
+
+    RelationTask (const vector< const Residue* > &res,
+		  const vector< pair< unsigned int, unsigned int > > &p,
+		  vector< Relation* > &rel)
+      : residues (res), pairs (p), relations (rel)
+    { }
+
+    virtual void run (unsigned int index)
+    {
+      unsigned int last = std::min ((index + 1) * SLICE, (unsigned int) pairs.size ());
+      unsigned int i;
+      
+      for (i = index * SLICE; i < last; ++i)
+	{
+	  const Residue *ref = residues[pairs[i].first];
+	  const Residue *res = residues[pairs[i].second];
+	  
+	  if (inContact (*ref, *res))
+	    {
+	      Relation *rel = new Relation (ref, res);
+
+	      if (! rel->annotate ())
+		{
+		  delete rel;
+		  rel = 0;
+		}
+	      relations[i] = rel;
+	    }
+	}
+    }
+
+  };
+  
+
+  void
+  AnnotateModel::relatePairs (const vector< pair< unsigned int, unsigned int > > &pairs,
+			      vector< bool > *related)
+  {
+    vector< const Residue* > residues (size ());
+    vector< Relation* > relations (pairs.size (), (Relation*) 0);
+    RelationTask task (residues, pairs, relations);
+    TaskPool pool (nbThreads);
+    unsigned int i;
+
+    for (i = 0; i < residues.size (); ++i)
+      {
+	residues[i] = internalGetVertex (i);
+      }
+    pool.run (task, (pairs.size () + RelationTask::SLICE - 1) / RelationTask::SLICE);
+
+    // The relations are added in pair order whatever the thread count.
+    if (0 != related)
+      {
+	related->assign (pairs.size (), false);
+      }
+    for (i = 0; i < relations.size (); ++i)
+      {
+	Relation *rel = relations[i];
+	
+	if (0 != rel)
+	  {
+	    Residue *ref = internalGetVertex (pairs[i].first);
+	    Residue *res = internalGetVertex (pairs[i].second);
+	    // invert works in place, so the reverse edge is a copy.
+	    Relation *inv = new Relation (*rel);
+
+	    connect (ref, res, rel);
+	    connect (res, ref, &inv->invert ());
+	    if (0 != related)
+	      {
+		(*related)[i] = true;
+	      }
+	  }
+      }
+  }
+
+  
+  void
+  AnnotateModel::freezeGraph ()
+  {
+    edge_iterator eit;
+    vector< AdjacencyTable::Edge > edges;
+
+    edges.reserve (edgeSize ());
     for (eit = edge_begin (); edge_end () != eit; ++eit)
       {
-	const Residue *ref;
-	const Residue *res;
+	AdjacencyTable::Edge e;
+
+	e.from = getVertexLabel (const_cast< Residue* > ((*eit)->getRef ()));
+	e.to = getVertexLabel (const_cast< Residue* > ((*eit)->getRes ()));
+	e.relation = *eit;
+	edges.push_back (e);
+      }
+    adjacency.build (size (), edges);
+  }
+
+
+  void
+  AnnotateModel::fillSeqBPStacks ()
+  {
+    label refLabel;
+    vector< pair< uint64_t, label > > resKeys;
+    vector< uint64_t > ranks (size ());
+    const vector< RelationTable::Face > noFaces;
+    label l;
+    unsigned int i;
+
+    // The residues are ranked in ResId order, a relation key is then the
+    // ranks of its residues.
+    resKeys.reserve (size ());
+    for (l = 0; l < (label) size (); ++l)
+      {
+	resKeys.push_back (make_pair (RelationTable::makeKey (internalGetVertex (l)->getResId ()), l));
+      }
+    std::sort (resKeys.begin (), resKeys.end ());
+    for (i = 0; i < resKeys.size (); ++i)
+      {
+	ranks[resKeys[i].second] = (0 != i && resKeys[i - 1].first == resKeys[i].first
+				    ? ranks[resKeys[i - 1].second]
+				    : i);
+      }
+
+    relationTable.clear ();
+    for (refLabel = 0; refLabel < (label) adjacency.size (); ++refLabel)
+      {
+	const label *nit = adjacency.neighborBegin (refLabel);
+	const label *nend = adjacency.neighborEnd (refLabel);
+	const Relation* const *rit = adjacency.relationBegin (refLabel);
 
-	if ((ref = (*eit)->getRef ())->getResId () < (res = (*eit)->getRes ())->getResId ())
+	for (; nend != nit; ++nit, ++rit)
 	  {
-	    GraphModel::label refLabel = getVertexLabel (const_cast< Residue* > (ref));
-	    GraphModel::label resLabel = getVertexLabel (const_cast< Residue* > (res));
-	
-	    if ((*eit)->isPairing ())
+	    label resLabel = *nit;
+	    LabelSet labels;
+	    unsigned char kind = 0;
+
+	    if (ranks[refLabel] >= ranks[resLabel])
+	      {
+		continue;
+	      }
+	    // The kinds are label classes, tested on the relation itself.
+	    labels = LabelTable::getSet ((*rit)->getLabels ());
+	    if ((*rit)->isPairing ())
+	      {
+		kind |= RelationTable::PAIR;
+	      }
+	    if ((*rit)->isStacking ())
 	      {
-		marks[refLabel] |= PAIRING_MARK;
-		marks[resLabel] |= PAIRING_MARK;
-		basepairs.push_back (BasePair (refLabel, ref->getResId (),
-					       resLabel, res->getResId ()));
+		kind |= RelationTable::STACK;
 	      }
-	    if ((*eit)->isStacking ())
+	    if ((*rit)->is (PropertyType::pAdjacent5p))
 	      {
-		stacks.push_back (BaseStack (refLabel, ref->getResId (),
-					     resLabel, res->getResId ()));
+		kind |= RelationTable::LINK;
 	      }
-	    if ((*eit)->is (PropertyType::pAdjacent5p))
+	    if (0 != kind)
 	      {
-		links.push_back (BaseLink (refLabel, ref->getResId (),
-					   resLabel, res->getResId ()));
+		relationTable.push_back (kind, refLabel, resLabel,
+					 ranks[refLabel] << 32 | ranks[resLabel],
+					 labels, *rit,
+					 0 != (kind & RelationTable::PAIR)
+					 ? (*rit)->getPairedFaces () : noFaces);
 	      }
 	  }
       }
+    relationTable.sort ();
+    fillRecords ();
+  }
+
+
+  void
+  AnnotateModel::fillRecords ()
+  {
+    unsigned int i;
+
+    // Each mask takes the label table lock, so they are taken once here
+    // rather than for every relation.
+    pairingMask = LabelTable::getMask (PropertyType::pPairing);
+    helixMask = (LabelTable::getMask (PropertyType::pSaenger)
+		 | LabelTable::getMask (PropertyType::pOneHbond));
+    stackMask = LabelTable::getMask (PropertyType::pStack);
+    adjacentMask = LabelTable::getMask (PropertyType::pAdjacent);
+
+    basepairs.clear ();
+    stacks.clear ();
+    links.clear ();
+    for (i = 0; i < relationTable.size (); ++i)
+      {
+	GraphModel::label refLabel = relationTable.getRef (i);
+	GraphModel::label resLabel = relationTable.getRes (i);
+	const ResId &refId = internalGetVertex (refLabel)->getResId ();
+	const ResId &resId = internalGetVertex (resLabel)->getResId ();
+
+	if (relationTable.is (i, RelationTable::PAIR))
+	  {
+	    marks[refLabel] |= PAIRING_MARK;
+	    marks[resLabel] |= PAIRING_MARK;
+	    basepairs.push_back (BasePair (refLabel, refId, resLabel, resId,
+					   relationTable.getLabels (i)));
+	  }
+	if (relationTable.is (i, RelationTable::STACK))
+	  {
+	    stacks.push_back (BaseStack (refLabel, refId, resLabel, resId,
+					 relationTable.getLabels (i)));
+	  }
+	if (relationTable.is (i, RelationTable::LINK))
+	  {
+	    links.push_back (BaseLink (refLabel, refId, resLabel, resId,
+				       relationTable.getLabels (i)));
+	  }
+      }
   }
   
 
-  bool
-  AnnotateModel::isHelixPairing (const Relation &r)
+  void
+  AnnotateModel::findStructures ()
   {
-    return (r.is (PropertyType::pPairing)
-	    && (r.is (PropertyType::pSaenger)
-		|| r.is (PropertyType::pOneHbond)));
+    findMultiplets ();
+    linkResidues ();
+    buildStrands ();
+    findHelices ();
+    findPseudoknots ();
+    buildDotBracket ();
+    findLoops ();
+    findKissingHairpins ();
+  }
+
+
+  void
+  AnnotateModel::linkResidues ()
+  {
+    vector< BaseLink >::const_iterator lit;
+
+    next3p.assign (size (), -1);
+    next5p.assign (size (), -1);
+    for (lit = links.begin (); links.end () != lit; ++lit)
+      {
+	if (lit->fResId.getChainId () == lit->rResId.getChainId ())
+	  {
+	    next3p[lit->first] = lit->second;
+	    next5p[lit->second] = lit->first;
+	  }
+      }
   }
-    
+
 
   void 
   AnnotateModel::findHelices ()
   {
-    list< BasePair > hPC;
-    vector< BasePair >::const_iterator bpit;
-
-    for (bpit = basepairs.begin (); basepairs.end () != bpit; ++bpit)
-      {
-	if (isHelixPairing (*internalGetEdge (bpit->first, bpit->second)))
-	  {
-	    hPC.push_back (*bpit);
-	  }
-      }
-//     while (! hPC.empty ())
-//       {
-// 	Helix helix;
-// 	list< BasePair >::iterator hpcIt;
-// 	label hfst;
-// 	label hsnd;
-// 	label tfst;
-// 	label tsnd;
-
-// 	hpcIt = hPC.begin ();
-// 	helix.push_back (*hpcIt);
-// 	hpcIt = hPC.erase (hpcIt);
-// 	hfst = helix.front ().first;
-// 	hsnd = helix.front ().second;
-// 	tfst = helix.back ().first;
-// 	tsnd = helix.back ().second;
-// 	while (hPC.end () != hpcIt)
-// 	  {
-// 	    label fst = hpcIt->first;
-// 	    label snd = hpcIt->second;
-// 	    bool inserted = false;
-	    
-// 	    if (((internalAreConnected (tfst, fst)
-// 		  && internalGetEdge (tfst, fst)->isAdjacent ())
-// 		 && (internalAreConnected (tsnd, snd)
-// 		     && (internalGetEdge (tsnd, snd)->isAdjacent ())))
-// 		|| ((internalAreConnected (tfst, snd)
-// 		     && internalGetEdge (tfst, snd)->isAdjacent ())
-// 		    && (internalAreConnected (tsnd, fst)
-// 			&& internalGetEdge (tsnd, fst)->isAdjacent ())
-// 		    && (hpcIt->reverse (), std::swap (fst, snd), true)))
-// 	      {
-// 		helix.push_back (*hpcIt);
-// 		tfst = fst;
-// 		tsnd = snd;
-// 		inserted = true;
-// 	      }
-// 	    else if (((internalAreConnected (fst, hfst)
-// 		       && internalGetEdge (fst, hfst)->isAdjacent ())
-// 		      && (internalAreConnected (snd, hsnd)
-// 			  && internalGetEdge (snd, hsnd)->isAdjacent ()))
-// 		     || ((internalAreConnected (fst, hsnd)
-// 			  && internalGetEdge (fst, hsnd)->isAdjacent ())
-// 			 && (internalAreConnected (snd, hfst)
-// 			     && internalGetEdge (snd, hfst)->isAdjacent ())
-// 			 && (hpcIt->reverse (), std::swap (fst,snd), true)))
-// 	      {
-// 		helix.insert (helix.begin (), *hpcIt);
-// 		hfst = fst;
-// 		hsnd = snd;
-// 		inserted = true;
-// 	      }
-// 	    if (inserted)
-// 	      {
-// 		hpcIt = hPC.erase (hpcIt);
-// 		if (hPC.end () == hpcIt)
-// 		  {
-// 		    hpcIt = hPC.begin ();
-// 		  }
-// 	      }
-// 	    else
-// 	      {
-// 		++hpcIt;
-// 	      }
-// 	  }
-// 	if (MIN_HELIX_SIZE <= helix.size ())
-// 	  {
-// 	    Helix::iterator hit;
-	    
-// 	    helix.setId (helices.size ());
-// 	    for (hit = helix.begin (); helix.end () != hit; ++hit)
-// 	      {
-// 		marks[hit->first] = LHELIX;
-// 		marks[hit->second] = RHELIX;
-// 	      }
-// 	    helices.push_back (helix);
-// 	  }
-//       }
+    // The end of a helix.
+    static const unsigned int NONE = 0xffffffff;
+    vector< unsigned int > candidates;
+    vector< unsigned int > candidateOf (adjacency.edgeSize (), NONE);
+    vector< unsigned int > next;
+    vector< bool > continued;
+    unsigned int i;
+
+    helices.clear ();
+    helix_mask.assign (size (), -1);
+
+    // The helix pairings (see isHelixPairing), by basepairs index.
+    for (i = 0; i < basepairs.size (); ++i)
+      {
+	if (isHelixPairing (basepairs[i].labels))
+	  {
+	    candidates.push_back (i);
+	  }
+      }
+    // The candidate of each pairing edge, found through the adjacency
+    // index.
+    for (i = 0; i < candidates.size (); ++i)
+      {
+	candidateOf[adjacency.find (basepairs[candidates[i]].first,
+				    basepairs[candidates[i]].second)] = i;
+      }
+
+    // The pairing (i, j) is followed in its helix by the pairing of the 3'
+    // neighbor of i with the 5' neighbor of j.  A pairing follows at most
+    // one other.
+    next.resize (candidates.size (), NONE);
+    continued.resize (candidates.size (), false);
+    for (i = 0; i < candidates.size (); ++i)
+      {
+	const BasePair &bp = basepairs[candidates[i]];
+	int fst = next3p[bp.first];
+	int snd = next5p[bp.second];
+	unsigned int e;
+	unsigned int n;
+
+	if (0 <= fst && 0 <= snd
+	    && AdjacencyTable::NONE != (e = adjacency.find (fst, snd))
+	    && NONE != (n = candidateOf[e])
+	    && ! continued[n])
+	  {
+	    next[i] = n;
+	    continued[n] = true;
+	  }
+      }
+
+    // Every helix starts at a pairing that follows no other.
+    for (i = 0; i < candidates.size (); ++i)
+      {
+	unsigned int length;
+	unsigned int n;
+
+	if (continued[i])
+	  {
+	    continue;
+	  }
+	for (n = i, length = 0; NONE != n; n = next[n])
+	  {
+	    ++length;
+	  }
+	if (MIN_HELIX_SIZE <= length)
+	  {
+	    Helix &helix = (helices.push_back (Helix ()), helices.back ());
+
+	    helix.setId (helices.size () - 1);
+	    helix.reserve (length);
+	    for (n = i; NONE != n; n = next[n])
+	      {
+		const BasePair &bp = basepairs[candidates[n]];
+
+		helix.push_back (bp);
+		marks[bp.first] |= LHELIX;
+		marks[bp.second] |= RHELIX;
+		helix_mask[bp.first] = helix.getId ();
+		helix_mask[bp.second] = helix.getId ();
+	      }
+	  }
+      }
   }
 
-  //     li = 0;
-  // //     while (gi != end ())
-  //     while (li < size ())
-  //       {
-  // 	// Find a pairing involving gi
-  // // 	neighbor = neighborhood (&*gi);
-  // 	neighbor = internalNeighborhood (li);
-  // 	for (nborIt = neighbor.begin (); neighbor.end () != nborIt; ++nborIt)
-  // 	  {
-  // // 	    if (isHelixPairing (getEdge ((Residue*) &*gi, *nborIt)))
-  // 	    if (isHelixPairing (*internalGetEdge (li, *nborIt)))
-  // 	      {
-  // 		break;
-  // 	      }
-  // 	  }
-
-  // 	if (nborIt != neighbor.end ())
-  // 	  {
-  // 	    Residue *ri = internalGetVertex (li);
-  // 	    Residue *rj = internalGetVertex (*nborIt);
-	    
-  // 	    if (ri->getResId () < rj->getResId () 
-  // 		&& marks.end () != marks.find (rj)
-  // 		&& marks[rj] != '('
-  // 		&& marks[rj] != ')')
-  // 	      {
-  // 		helix.push_back (make_pair (ri, rj));
-          
-  // 		// Extending with bulge detection
-  // 		while (true)
-  // 		  {
-  // 		    lip++ = li;
-  // 		    if (gip == size ()
-  // 		      {
-  // 			break;
-  // 		      }
-  // 		    if (gk == begin ())
-  // 		      {
-  // 			break;
-  // 		      }
-  // 		    gkp-- = gk;
-        
-  // 		    if (sequence_mask[&*gip] == sequence_mask[&*gi]
-  // 			&& sequence_mask[&*gkp] == sequence_mask[&*gk])
-  // 		      {
-  // 			neighbor = neighborhood ((Residue*) &*gip);
-  // 			if ((nborIt = std::find (neighbor.begin (), neighbor.end (), (Residue*) &*gkp)) != neighbor.end ()
-  // 			    && isHelixPairing (getEdge ((Residue*) &*gip, (Residue*) &*gkp)))
-  // 			  {
-  // 			    helix.push_back (make_pair ((Residue*) &*gip, (Residue*) &*gkp));
-  // 			    gi = gip;
-  // 			    gk = gkp;
-  // 			  }
-  // 			else
-  // 			  {
-  // 			    break;
-  // 			  }
-  // 		      }
-  // 		    else
-  // 		      {
-  // 			break;
-  // 		      }
-  // 		  }
-		
-  // 		if ((int) helix.size () >= MIN_HELIX_SIZE)
-  // 		  {
-  // 		    Helix::iterator i;
-		    
-  // 		    for (i = helix.begin (); i != helix.end (); ++i)
-  // 		      {
-  // 			helix_mask[i->first] = helices.size ();
-  // 			marks[i->first] = '(';
-  // 			helix_mask[i->second] = helices.size ();
-  // 			marks[i->second] = ')';
-  // 		      }
-  // 		    helices.push_back (helix);
-  // 		  } 
-  // 		helix.clear ();
-  // 	      }
-  // 	  }
-  // 	++gi;
-  //       }
-  //   }
 
   /**
    * Output helices in text representation
@@ -316,7 +687,7 @@ namespace annotate
    *      B14-AAUAUAUAUAUAUU-B1
    */
   void
-  AnnotateModel::dumpHelices () const 
+  AnnotateModel::dumpHelices (TextWriter &tw, const vector< string > &resIds) const
   {
     vector< Helix >::const_iterator i;
     
@@ -325,740 +696,1178 @@ namespace annotate
 	Helix::const_iterator hIt;
 	
 	// Helix index and length
-	gOut (0) << "H" << i - helices.begin () << ", length = " << i->size ()
-		 << endl;
+	tw.put ('H').put ((unsigned long) (i - helices.begin ()))
+	  .put (", length = ").put ((unsigned long) i->size ()).endl ();
 	
 	// First strand
-	gOut (0).setf (ios::right, ios::adjustfield);
-	gOut (0) << setw (6) << internalGetVertex (i->front ().first)->getResId () << "-";
+	tw.putRight (resIds[i->front ().first], 6).put ('-');
 	for (hIt = i->begin (); i->end () != hIt; ++hIt)
 	  {
 	    const ResidueType *type = internalGetVertex (hIt->first)->getType ();
 	    
-	    gOut (0) << (type->isNucleicAcid ()
-			 ? Pdbstream::stringifyResidueType (type)
-			 : "X");
+	    tw.put (type->isNucleicAcid ()
+		    ? Pdbstream::stringifyResidueType (type)
+		    : "X");
 	  }
-	--hIt;
-	gOut (0) << "-" << internalGetVertex (hIt->first)->getResId () << endl;
+	tw.put ('-').put (resIds[i->back ().first]).endl ();
 
 	// Second strand 
-	gOut (0).setf (ios::right, ios::adjustfield);
-	gOut (0) << setw (6) << internalGetVertex (i->front ().second)->getResId () << "-";
+	tw.putRight (resIds[i->front ().second], 6).put ('-');
 	for (hIt = i->begin (); i->end () != hIt; ++hIt)
 	  {
 	    const ResidueType *type = internalGetVertex (hIt->second)->getType ();
 	    
-	    gOut (0) << (type->isNucleicAcid ()
-			 ? Pdbstream::stringifyResidueType (type)
-			 : "X");
+	    tw.put (type->isNucleicAcid ()
+		    ? Pdbstream::stringifyResidueType (type)
+		    : "X");
 	  }
-	--hIt;
-	gOut (0) << "-" << internalGetVertex (hIt->second)->getResId() << endl;
+	tw.put ('-').put (resIds[i->back ().second]).endl ();
       }
-    gOut (0).setf (ios::left, ios::adjustfield);
   }
 
   
-  void
-  AnnotateModel::findStrands ()
+  void 
+  AnnotateModel::buildStrands ()
   {
+    vector< BaseLink >::const_iterator lit;
+    unsigned int pass;
+
+    sequences.clear ();
+    sequence_mask.assign (size (), -1);
+    sequence_rank.assign (size (), -1);
+    // The links are in key order, so are the strands starting at a residue
+    // without 5' neighbor.  The second pass gets the circular strands.
+    for (pass = 0; pass < 2; ++pass)
+      {
+	for (lit = links.begin (); links.end () != lit; ++lit)
+	  {
+	    int l = lit->first;
 
-//     const_iterator gi, gk, gl;
-//     map< const Residue*, int >::iterator gf;
-//     OStrand strand;
+	    if (-1 != sequence_mask[l]
+		|| -1 == next3p[l]
+		|| (0 == pass && -1 != next5p[l]))
+	      {
+		continue;
+	      }
+	    sequences.push_back (Strand ());
+	    for (; -1 != l && -1 == sequence_mask[l]; l = next3p[l])
+	      {
+		const Residue *r = internalGetVertex (l);
 
-//     for (gi=begin (); gi!=end (); )
-//     {
-//       if (helix_mask.find(&(*gi)) == helix_mask.end()) {
-      
-//         gk = gi;
-//         while (gk != end () &&
-//             helix_mask.find(&(*gk)) == helix_mask.end() &&
-//             sequence_mask[&(*gi)] == sequence_mask[&(*gk)]
-//             )
-//           ++gk;
-//         gk--;
-//         strand.first = &(*gi);
-//         strand.second = &(*gk);
-//         strand.type = OTHER;
-//         for (gl = gi; gl<=gk; ++gl) { 
-//           strand_mask[&(*gl)] = strands.size ();
-//         }
-//         strands.push_back (strand);
-//         gi = gk;
-//       }
-//       gi++;
-//     }
+		sequence_mask[l] = sequences.size () - 1;
+		sequence_rank[l] = sequences.addResId (&r->getResId (), l);
+		sequences.back ().push_back (r);
+	      }
+	  }
+      }
   }
 
-    
-  void 
-  AnnotateModel::buildStrands ()
+
+  void
+  AnnotateModel::findLoops ()
   {
-//     list< edge_const_iterator > unsorted;
-//     edge_const_iterator edgeIt;
+    StrandSet::const_iterator sit;
+    vector< unsigned int > open;
+    vector< int > renumber;
+    unsigned int base;
+    unsigned int i;
+    unsigned int n;
+
+    strands.clear ();
+    loops.clear ();
+    strand_mask.assign (size (), -1);
+    for (sit = sequences.begin (), base = 0; sequences.end () != sit; base += (sit++)->size ())
+      {
+	unsigned int id;
 
-//     sequences.clear ();
-//     for (edgeIt = edge_begin (); edge_end () != edgeIt; ++edgeIt)
-//       {
-// 	if ((*edgeIt)->is (PropertyType::pAdjacent5p))
-// 	  {
-// 	    unsorted.push_back (edgeIt);
-// 	  }
-//       }
-//     while (! unsorted.empty ())
-//       {
-// 	edge_const_iterator sj;
-// 	list< edge_const_iterator > sorted;
-// 	list< edge_const_iterator >::iterator it;
-    
-// 	sj = unsorted.front ();
-// 	unsorted.pop_front ();
-// 	sorted.push_back (sj);
-// 	for (it = unsorted.begin (); unsorted.end () != it;)
-// 	  {
-// 	    if ((**it)->getRes ()->getResId () == (*sj)->getRef ()->getResId ())
-// 	      {
-// 		sj = *it;
-// 		sorted.push_front (sj);
-// 		unsorted.erase (it);
-// 		it = unsorted.begin ();
-// 	      }
-// 	    else
-// 	      {
-// 		++it;
-// 	      }
-// 	  }
-// 	sj = sorted.back ();
-// 	for (it = unsorted.begin (); unsorted.end () != it;)
-// 	  {
-// 	    if ((**it)->getRef ()->getResId () == (*sj)->getRes ()->getResId ())
-// 	      {
-// 		sj = *it;;
-// 		sorted.push_back (sj);
-// 		unsorted.erase (it);
-// 		it = unsorted.begin ();
-// 	      }
-// 	    else
-// 	      {
-// 		++it;
-// 	      }
-// 	  }
-// 	sequences.push_back (Strand ());
-// 	Strand &seq = sequences.back ();
-    
-// 	it = sorted.begin ();
-// 	seq.push_back ((**it)->getRef ());
-// 	while (sorted.end () != it)
-// 	  {
-// 	    seq.push_back ((**it)->getRes ());
-// 	    ++it;
-// 	  }
-//       }
+	open.assign (1, loops.size ());
+	loops.push_back (OLoop ());
+	loops.back ().type = OTHER;
+	loops.back ().closed = false;
+	for (id = base; id < base + sit->size (); ++id)
+	  {
+	    label l = sequences.getLabel (id);
+	    char c = dot_bracket[id];
 
-//     // Verify that the sequences have the same chain id and have consecutive
-//     // residue number.
-//     StrandSet::iterator seqIt;
-//     int k = 0;
-
-//     for (seqIt = sequences.begin (); sequences.end () != seqIt; ++seqIt, ++k)
-//       {
-// 	Strand &resVec = *seqIt;
-// 	Strand::iterator resVecIt;
-// 	char chain;
-// 	int number;
-// 	int len = 1;
-    
-// 	resVecIt = resVec.begin ();
-// 	chain = (*resVecIt)->getResId ().getChainId ();
-// 	number = (*resVecIt)->getResId ().getResNo ();
-// 	sequence_mask[*resVecIt] = k;
-// 	++resVecIt;
-// 	while (resVec.end () != resVecIt)
-// 	  {
-// 	    if ((*resVecIt)->getResId ().getChainId () != chain
-// 		|| (*resVecIt)->getResId ().getResNo () != number + 1)
-// 	      {
-// 		Strand rest;
-      
-// 		if (++resVec.begin () == resVecIt)
-// 		  {
-// 		    rest.insert (rest.end (), resVecIt, resVec.end ());
-// 		    resVec.erase (++resVecIt, resVec.end ());
-// 		  }
-// 		else
-// 		  {
-// 		    rest.insert (rest.end (), resVecIt - 1, resVec.end ());
-// 		    resVec.erase (resVecIt, resVec.end ());
-// 		  }
-// 		++seqIt;
-// 		if (1 < rest.size ())
-// 		  {
-// 		    seqIt = --sequences.insert (seqIt, rest);
-// 		  }
-// 		break;
-// 	      }
-// 	    else
-// 	      {
-// 		sequence_mask[*resVecIt] = k;
-// 		number += 1;
-// 		++resVecIt;
-// 		len++;
-// 	      }
-// 	  }
-// 	sequence_length.push_back(len);
-//       }
-  }
+	    if ('(' == c)
+	      {
+		open.push_back (loops.size ());
+		loops.push_back (OLoop ());
+		loops.back ().closed = true;
+		loops.back ().pairs.push_back (make_pair (l, l));
+	      }
+	    else if (')' == c)
+	      {
+		OLoop &loop = loops[open.back ()];
+		unsigned int nbBranches = loop.pairs.size () - 1;
+
+		loop.pairs.front ().second = l;
+		if (0 == nbBranches)
+		  {
+		    loop.type = LOOP;
+		  }
+		else if (1 == nbBranches)
+		  {
+		    int left = sequence_rank[loop.pairs[1].first] - sequence_rank[loop.pairs[0].first] - 1;
+		    int right = sequence_rank[loop.pairs[0].second] - sequence_rank[loop.pairs[1].second] - 1;
+
+		    loop.type = (0 == left && 0 == right ? HELIX
+				 : 0 == left || 0 == right ? BULGE
+				 : INTERNAL_LOOP);
+		  }
+		else
+		  {
+		    loop.type = JUNCTION;
+		  }
+		open.pop_back ();
+		loops[open.back ()].pairs.push_back (loop.pairs.front ());
+	      }
+	    else
+	      {
+		OLoop &loop = loops[open.back ()];
+
+		// The run goes on from an unpaired residue.
+		if (base < id && '(' != dot_bracket[id - 1] && ')' != dot_bracket[id - 1])
+		  {
+		    strands.back ().second = id;
+		  }
+		else
+		  {
+		    OStrand strand;
+
+		    strand.first = strand.second = id;
+		    strand.ref = open.back ();
+		    loop.strands.push_back (strands.size ());
+		    strands.push_back (strand);
+		  }
+		strand_mask[l] = open.back ();
+	      }
+	  }
+      }
 
-//   void AnnotateModel::classifyStrands ()  {
-//     vector< OStrand >::iterator j;
-//     const_iterator first, last, prev, next;
-  
-//     for (j=strands.begin (); j!=strands.end (); ++j) {
-  
-//       prev = find((*(j->first)).getResId());
-//       next = find((*(j->second)).getResId());
-//       --prev; ++next;
-//       first = begin();
-//       last = end();
-//       --last;
-  
-//       if (&(*(j->first)) == &(*first) || &(*(j->second)) == &(*last) ||
-//         sequence_mask[&(*prev)] != sequence_mask[&(*next)])
-//       {
-//         j->type = OTHER;
-//       }
-//       else if (helix_mask[&(*prev)] == helix_mask[&(*next)])
-//       {
-//         const Residue *i = 0;
-//         // Find pairs of the extrimities.
-//         if (helices[helix_mask[&(*prev)]].front ().first == &(*prev))
-//           i = helices[helix_mask[&(*prev)]].front ().second;
-//         else if (helices[helix_mask[&(*prev)]].front ().second == &(*prev))
-//           i = helices[helix_mask[&(*prev)]].front ().first;
-//         else if (helices[helix_mask[&(*prev)]].back ().first == &(*prev))
-//           i = helices[helix_mask[&(*prev)]].back ().second;
-//         else if (helices[helix_mask[&(*prev)]].back ().second == &(*prev))
-//           i = helices[helix_mask[&(*prev)]].back ().first;
-//         else 
-//           cerr << "Pairing not found for (a) " << *prev << endl;
-  
-//         if (i == &(*next))
-//           j->type = LOOP;
-//         else 
-//           j->type = BULGE_OUT;
-//       }
-//       else
-//       { 
-//         const Residue *i = 0, *k = 0;
-    
-//         // Find pairs.
-//         if (helices[helix_mask[j->first-1]].front ().first == j->first-1)
-//           i = helices[helix_mask[j->first-1]].front ().second;
-//         else if (helices[helix_mask[j->first-1]].front ().second == j->first-1)
-//           i = helices[helix_mask[j->first-1]].front ().first;
-//         else if (helices[helix_mask[j->first-1]].back ().first == j->first-1)
-//           i = helices[helix_mask[j->first-1]].back ().second;
-//         else if (helices[helix_mask[j->first-1]].back ().second == j->first-1)
-//           i = helices[helix_mask[j->first-1]].back ().first;
-//         else 
-//           cerr << "Pairing not found for (b) " << j->first-1 << endl;
-      
-//         if (helices[helix_mask[j->second+1]].front ().first == j->second+1)
-//           k = helices[helix_mask[j->second+1]].front ().second;
-//         else if (helices[helix_mask[j->second+1]].front ().second == j->second+1)
-//           k = helices[helix_mask[j->second+1]].front ().first;
-//         else if (helices[helix_mask[j->second+1]].back ().first == j->second+1)
-//           k = helices[helix_mask[j->second+1]].back ().second;
-//         else if (helices[helix_mask[j->second+1]].back ().second == j->second+1)
-//           k = helices[helix_mask[j->second+1]].back ().first;
-//         else 
-//           cerr << "Pairing not found for (c) " << j->first-1 << endl;
-      
-//         if (sequence_mask[i] != sequence_mask[k]) {
-//           j->type = OTHER;
-//         } else if (i==k+1 || i==k-1) {
-//           j->type = BULGE;
-//         } else {
-//           // Find the other part of the internal loop
-//           vector< OStrand >::iterator s;
-//           for (s=strands.begin (); s!=strands.end (); ++s) {
-//             if (s->first == k+1 && s->second == i-1) {
-//               j->type = INTERNAL_LOOP;
-//               j->ref = s-strands.begin ();  // FIXIT!
-//               break;
-//             } else {
-//               j->type = OTHER;
-//             }
-//           }
-//         }
-//       }    
-//     }
-//   }
-  
-//   void AnnotateModel::dumpStrands ()
-//   {
-//     int j;
-//     const_iterator k;
-  
-//     for (j=0; j<(int)strands.size (); ++j) {
-      
-//       gOut(0).setf (ios::left, ios::adjustfield);
-//       gOut(0) << "S" << setw (5) << j << " ";
-      
-//       gOut(0).setf (ios::left, ios::adjustfield);
-      
-//       if (strands[j].type == OTHER) gOut(0) << setw (16) << "single strand:";
-//       else if (strands[j].type == BULGE) gOut(0) << setw (16) << "bulge:";
-//       else if (strands[j].type == BULGE_OUT) gOut(0) << setw (16) << "bulge out:";
-//       else if (strands[j].type == LOOP) gOut(0) << setw (16) << "loop:";
-//       else if (strands[j].type == INTERNAL_LOOP) gOut(0) << setw (16) << "internal loop:";
-      
-//       gOut(0) << (strands[j].first)->getResId() << "-";
-      
-//       for (k = find((strands[j].first)->getResId()); k <= find((strands[j].second)->getResId()); ++k) {
-//         gOut(0) << ((k)->getType()->isNucleicAcid () ? Pdbstream::stringifyResidueType ((k)->getType()) : "X");
-//       }
-//       gOut(0) << "-" << (strands[j].second)->getResId();
-  
-//       if (strands[j].type == INTERNAL_LOOP) {
-//         gOut(0) << " -- ";
-//       // FIXIT!    
-//   /*      gOut(0) << (strands[strands[j].ref].first)->getResId() << "-";
-//         for (k=strands[strands[j].ref].first; k<=strands[strands[j].ref].second; ++k) {
-//           gOut(0) << ((k)->getType()->isNucleicAcid () ? Pdbstream::stringifyResidueType ((k)->getType()) : "X");
-//         }
-//         gOut(0) << "-" << (strands[strands[j].ref].second)->getResId();
-//   */      
-//       }
-//       gOut(0) << endl;
-//     }
-//     gOut(0).setf (ios::left, ios::adjustfield);  
-//   }
+    // The stacked pairs are dropped, the loops keep their order.
+    renumber.resize (loops.size (), -1);
+    for (i = 0, n = 0; i < loops.size (); ++i)
+      {
+	if (HELIX != loops[i].type)
+	  {
+	    vector< unsigned int >::const_iterator it;
+
+	    for (it = loops[i].strands.begin (); loops[i].strands.end () != it; ++it)
+	      {
+		strands[*it].type = loops[i].type;
+		strands[*it].ref = n;
+	      }
+	    renumber[i] = n;
+	    if (i != n)
+	      {
+		loops[n] = loops[i];
+	      }
+	    ++n;
+	  }
+      }
+    loops.resize (n);
+    for (i = 0; i < strand_mask.size (); ++i)
+      {
+	if (-1 != strand_mask[i])
+	  {
+	    strand_mask[i] = renumber[strand_mask[i]];
+	  }
+      }
+  }
+
+
+  void
+  AnnotateModel::dumpLoops (TextWriter &tw, const vector< string > &resIds) const
+  {
+    vector< OLoop >::const_iterator lit;
+
+    for (lit = loops.begin (); loops.end () != lit; ++lit)
+      {
+	vector< pair< label, label > >::const_iterator pit;
+	vector< unsigned int >::const_iterator sit;
+
+	tw.put ('L').put ((unsigned long) (lit - loops.begin ())).put (' ');
+	switch (lit->type)
+	  {
+	  case LOOP:
+	    tw.put ("hairpin loop");
+	    break;
+	  case BULGE:
+	    tw.put ("bulge");
+	    break;
+	  case INTERNAL_LOOP:
+	    tw.put ("internal loop");
+	    break;
+	  case JUNCTION:
+	    tw.put ((unsigned long) lit->pairs.size ()).put ("-way junction");
+	    break;
+	  default:
+	    tw.put ("exterior loop");
+	    break;
+	  }
+	tw.put (" :");
+	for (pit = lit->pairs.begin (); lit->pairs.end () != pit; ++pit)
+	  {
+	    tw.put (' ').put (resIds[pit->first]).put ('-').put (resIds[pit->second]);
+	  }
+	tw.put (" :");
+	for (sit = lit->strands.begin (); lit->strands.end () != sit; ++sit)
+	  {
+	    tw.put (' ');
+	    dumpRun (tw, resIds, strands[*sit].first, strands[*sit].second);
+	  }
+	tw.endl ();
+      }
+  }
+
+
+  void
+  AnnotateModel::dumpRun (TextWriter &tw, const vector< string > &resIds,
+			  unsigned int first, unsigned int last) const
+  {
+    unsigned int id;
+
+    tw.put (resIds[sequences.getLabel (first)]).put ('-');
+    for (id = first; id <= last; ++id)
+      {
+	const ResidueType *type = internalGetVertex (sequences.getLabel (id))->getType ();
+
+	tw.put (type->isNucleicAcid () ? Pdbstream::stringifyResidueType (type) : "X");
+      }
+    tw.put ('-').put (resIds[sequences.getLabel (last)]);
+  }
 
   
   void
   AnnotateModel::findKissingHairpins ()
   {
-//     const_iterator gi;
-//     list< Residue* > neighbor;
-//     list< Residue* >::iterator nborIt;
-//     int check = 0;
-//     int nb_helical_bp = 0;
-//     set< const PropertyType* >::iterator k;
-  
-//     gOut(0).setf (ios::left, ios::adjustfield);
-  
-//     for (gi=begin (); gi!=end (); ++gi) {
-//       neighbor = neighborhood (const_cast<Residue*> (&(*gi)));  
-//       for (nborIt = neighbor.begin (); nborIt != neighbor.end (); ++nborIt) {      
-//         if (gi->getResId() < (*nborIt)->getResId() && isPairing (getEdge ((Residue*)(&(*gi)), *nborIt))) {
-          
-//           if (helix_mask.find(&(*gi)) != helix_mask.end() &&
-//               helix_mask [&(*gi)] == helix_mask [*nborIt]) {
-//             // Simple helical base-pair.
-//             gOut(0) << setw (20) << "helix bp: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-//             check++;
-//             nb_helical_bp++;
-//           } 
-      
-//           if (helix_mask.find(&(*gi)) != helix_mask.end() &&
-//               helix_mask [&(*gi)] != helix_mask [*nborIt]) {
-//             gOut(0) << setw (20) << "inter helix: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-//             tertiary_mask[&(*gi)] = 1;
-//             tertiary_mask[*nborIt] = 1;
-//             check++;
-//           }
-  
-//           if (strand_mask.find(&(*gi)) != strand_mask.end() &&
-//               helix_mask.find(&(*gi)) != helix_mask.end()) {
-//             if (strands[strand_mask [&(*gi)]].type == OTHER) {
-//               gOut(0) << setw (20) << "strand/helix: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-// 	      tertiary_mask[&(*gi)] = 1;
-// 	      tertiary_mask[*nborIt] = 1;
-//               check++;
-//             } else if (strands[strand_mask [&(*gi)]].type == BULGE ||
-// 		       strands[strand_mask [&(*gi)]].type == BULGE_OUT) {
-//               gOut(0) << setw (20) << "bulge/helix: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-// 	      tertiary_mask[&(*gi)] = 1;
-// 	      tertiary_mask[*nborIt] = 1;
-//               check++;
-//             } else if (strands[strand_mask [&(*gi)]].type == LOOP) {
-//               gOut(0) << setw (20) << "loop/helix: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-// 	      tertiary_mask[&(*gi)] = 1;
-// 	      tertiary_mask[*nborIt] = 1;
-//               check++;
-//             } else if (strands[strand_mask [&(*gi)]].type == INTERNAL_LOOP) {
-//               gOut(0) << setw (20) << "internal loop/helix: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-// 	      tertiary_mask[&(*gi)] = 1;
-// 	      tertiary_mask[*nborIt] = 1;
-//               check++;
-//             } else {
-//               gOut(0) << "Other A: " << " : ";
-//             }
-//           }
-  
-//           if (strand_mask.find(&(*gi)) != strand_mask.end() &&
-//               strand_mask.find(*nborIt) != strand_mask.end()) {
-            
-//             if (strand_mask [&(*gi)] == strand_mask [*nborIt]) {
-//               gOut(0) << setw (20) << "intraloop: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-// 	      tertiary_mask[&(*gi)] = 1;
-// 	      tertiary_mask[*nborIt] = 1;
-//               check++;
-//             } else {             
-//               int size = 0;
-//               if (strands[strand_mask [&(*gi)]].type == OTHER) {
-//                 gOut(0) << "strand/";
-//                 size = 20-7;	    
-//               } else if (strands[strand_mask [&(*gi)]].type == BULGE || 
-// 			 strands[strand_mask [&(*gi)]].type == BULGE_OUT) {
-//                 gOut(0) << "bulge/";
-//                 size = 20-6;
-//               } else if (strands[strand_mask [&(*gi)]].type == LOOP) {
-//                 gOut(0) << "loop/";
-//                 size = 20-5;
-//               } else if (strands[strand_mask [&(*gi)]].type == INTERNAL_LOOP) {
-//                 gOut(0) << "internal loop/";
-//                 size = 20-14;
-//               }              
-//               if (strands[strand_mask [*nborIt]].type == OTHER) {
-//                 gOut(0) << setw (size) << "strand: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-//                 tertiary_mask[&(*gi)] = 1;
-//                 tertiary_mask[*nborIt] = 1;
-//                 check++;
-// 	      } else if (strands[strand_mask [*nborIt]].type == BULGE ||
-// 			 strands[strand_mask [*nborIt]].type == BULGE_OUT) {
-//                 gOut(0) << setw (size) << "bulge: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-//                 tertiary_mask[&(*gi)] = 1;
-//                 tertiary_mask[*nborIt] = 1;
-//                 check++;
-//               } else if (strands[strand_mask [*nborIt]].type == LOOP) {
-//                 gOut(0) << setw (size) << "loop: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-//                 tertiary_mask[&(*gi)] = 1;
-//                 tertiary_mask[*nborIt] = 1;
-//                 check++;
-//               } else if (strands[strand_mask [*nborIt]].type == INTERNAL_LOOP) {
-//                 gOut(0) << setw (size) << "internal loop: " << gi->getResId() << "-" << (*nborIt)->getResId() << " : ";
-//                 tertiary_mask[&(*gi)] = 1;
-//                 tertiary_mask[*nborIt] = 1;
-//                 check++;
-//               } else {
-//                 gOut(0) << "Other B:" << " : ";
-//               }
-//             }
-//           }
-         
-//           gOut(0) << Pdbstream::stringifyResidueType (gi->getType()) << "-"
-//                   << Pdbstream::stringifyResidueType ((*nborIt)->getType()) << " ";
-          
-//           Relation *e = getEdge ((Residue*) &(*gi), *nborIt);
-                   
-//           if (isPairing(e))
-//             gOut(0) << e->getRefFace () << "/" << e->getResFace () << " ";
- 
-//           const set< const PropertyType* > &labels = e->getLabels();
-//           copy (labels.begin (), labels.end (), ostream_iterator< const PropertyType* > (gOut(0), " "));          
-//           gOut(0) << endl;       
-//         }
-//       }
-//     }
-//     gOut(0) << "Number of base pairs = " << nb_pairings << endl;
-//     gOut(0) << "Number of helical base pairs = " << nb_helical_bp << endl;
-  
-//     if (nb_pairings != check) 
-//       gOut(0) << "Missing interactions: " << check << "/" << nb_pairings << endl;
+    vector< pair< pair< unsigned int, unsigned int >, unsigned int > > kissing;
+    unsigned int row;
+    unsigned int i;
+
+    tertiary_mask.assign (size (), 0);
+    tertiaryRows.clear ();
+    kissingRows.clear ();
+    kissingLoops.clear ();
+    nbPairings = nbHelicalPairings = nbClassified = 0;
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	if (relationTable.is (row, RelationTable::PAIR))
+	  {
+	    label ref = relationTable.getRef (row);
+	    label res = relationTable.getRes (row);
+	    int rl = strand_mask[ref];
+	    int sl = strand_mask[res];
+
+	    ++nbPairings;
+	    if (-1 != helix_mask[ref] && helix_mask[ref] == helix_mask[res])
+	      {
+		++nbHelicalPairings;
+		++nbClassified;
+	      }
+	    else if (0 != getRegionName (ref) && 0 != getRegionName (res))
+	      {
+		++nbClassified;
+		tertiaryRows.push_back (row);
+		tertiary_mask[ref] = tertiary_mask[res] = 1;
+		if (-1 != rl && -1 != sl && rl != sl
+		    && LOOP == loops[rl].type && LOOP == loops[sl].type)
+		  {
+		    kissing.push_back (make_pair (make_pair (std::min (rl, sl), std::max (rl, sl)), row));
+		  }
+	      }
+	  }
+      }
+
+    // The pairs of the same two hairpin loops form one complex.
+    std::sort (kissing.begin (), kissing.end ());
+    for (i = 0; i < kissing.size (); ++i)
+      {
+	if (0 == i || kissing[i - 1].first != kissing[i].first)
+	  {
+	    kissingLoops.push_back (kissing[i].first);
+	  }
+	kissingRows.push_back (make_pair (kissing[i].second, kissingLoops.size () - 1));
+      }
+  }
+
+
+  const char*
+  AnnotateModel::getRegionName (label l) const
+  {
+    if (-1 != helix_mask[l])
+      {
+	return "helix";
+      }
+    if (-1 == strand_mask[l])
+      {
+	return 0;
+      }
+    switch (loops[strand_mask[l]].type)
+      {
+      case BULGE:
+	return "bulge";
+      case INTERNAL_LOOP:
+	return "internal loop";
+      case LOOP:
+	return "loop";
+      case JUNCTION:
+	return "junction";
+      default:
+	return "strand";
+      }
+  }
+
+
+  void
+  AnnotateModel::dumpTertiaries (TextWriter &tw, const vector< string > &resIds,
+				 const LabelOrder &order) const
+  {
+    vector< unsigned int >::const_iterator rit;
+    unsigned int i;
+
+    for (rit = tertiaryRows.begin (); tertiaryRows.end () != rit; ++rit)
+      {
+	label ref = relationTable.getRef (*rit);
+	label res = relationTable.getRes (*rit);
+	string type;
+
+	if (-1 != helix_mask[ref] && -1 != helix_mask[res])
+	  {
+	    type = "inter helix";
+	  }
+	else if (-1 != strand_mask[ref] && strand_mask[ref] == strand_mask[res])
+	  {
+	    type = "intraloop";
+	  }
+	else if (-1 != helix_mask[ref])
+	  {
+	    // The helix comes last, as in loop/helix.
+	    type = string (getRegionName (res)) + "/helix";
+	  }
+	else
+	  {
+	    // The rows were kept for having both regions named.
+	    type = string (getRegionName (ref)) + "/" + getRegionName (res);
+	  }
+	tw.put (type).put (": ");
+	for (i = type.size () + 2; i < 20; ++i)
+	  {
+	    tw.put (' ');
+	  }
+	dumpPair (tw, *rit, resIds, order);
+      }
+    for (i = 0; i < kissingRows.size (); ++i)
+      {
+	unsigned int k = kissingRows[i].second;
+
+	if (0 == i || kissingRows[i - 1].second != k)
+	  {
+	    if (0 != i)
+	      {
+		tw.endl ();
+	      }
+	    tw.put ("Kissing loops K").put ((unsigned long) k)
+	      .put (" : L").put ((unsigned long) kissingLoops[k].first)
+	      .put (" L").put ((unsigned long) kissingLoops[k].second).put (" :");
+	  }
+	tw.put (' ').put (resIds[relationTable.getRef (kissingRows[i].first)])
+	  .put ('-').put (resIds[relationTable.getRes (kissingRows[i].first)]);
+      }
+    if (! kissingRows.empty ())
+      {
+	tw.endl ();
+      }
+    tw.put ("Number of base pairs = ").put ((unsigned long) nbPairings).endl ();
+    tw.put ("Number of helical base pairs = ").put ((unsigned long) nbHelicalPairings).endl ();
+    if (nbPairings != nbClassified)
+      {
+	tw.put ("Missing interactions: ").put ((unsigned long) nbClassified)
+	  .put ('/').put ((unsigned long) nbPairings).endl ();
+      }
   }
 
 
   void
   AnnotateModel::findPseudoknots ()
   {
-//   vector< Helix >::iterator i, j;
-  
-//   for (i=helices.begin (); i!=helices.end (); ++i) {
-//     if (strand_mask[i->front ().first] == 
-// 	strand_mask[i->front ().second]) { 
-//       const Residue *a, *b, *c, *d;
-//       a = (*i).front ().first;
-//       b = (*i).back ().first;
-//       c = (*i).back ().second;
-//       d = (*i).front ().second;
-//       for (j=i; j!=helices.end (); ++j) {
-// 	if (i!=j && strand_mask[j->front ().first] == 
-// 	    strand_mask[j->front ().second]) {
-// 	  const Residue *ap, *bp, *cp, *dp;
-// 	  ap = (*j).front ().first;
-// 	  bp = (*j).back ().first;
-// 	  cp = (*j).back ().second;
-// 	  dp = (*j).front ().second;
-	  
-// 	  if (b->getResId() < ap->getResId() && bp->getResId() < c->getResId() && d->getResId() < cp->getResId()) {
-// 	    gOut(0) << "Pseudoknot : " << "H" << helix_mask[a]+1 << " " 
-// 		 << "H" << helix_mask[ap]+1 << endl;
-// 	  }
-// 	}
-//       }
-//     }
-//   }
+    const vector< int > &rank = sequence_rank;
+    vector< pair< unsigned int, unsigned int > > starts;
+    vector< pair< unsigned int, unsigned int > >::const_iterator sit;
+    vector< pair< unsigned int, unsigned int > > byEnd;
+    vector< pair< unsigned int, unsigned int > > byLength;
+    vector< unsigned int > ends (helices.size (), 0);
+    vector< unsigned int > slots (helices.size (), 0);
+    vector< unsigned int > degree (helices.size () + 1, 0);
+    vector< unsigned int > neighbors;
+    vector< unsigned int > taken;
+    RankTree tree;
+    unsigned int i;
+
+    crossings.clear ();
+    helix_order.assign (helices.size (), 0);
+
+    // The spans of the helices within a strand, the outer pairing of a
+    // helix being its first.
+    for (i = 0; i < helices.size (); ++i)
+      {
+	const BasePair &outer = helices[i].front ();
+
+	if (-1 != sequence_mask[outer.first]
+	    && sequence_mask[outer.first] == sequence_mask[outer.second])
+	  {
+	    starts.push_back (make_pair (std::min (rank[outer.first], rank[outer.second]), i));
+	    ends[i] = std::max (rank[outer.first], rank[outer.second]);
+	    byEnd.push_back (make_pair (ends[i], i));
+	  }
+      }
+    std::sort (starts.begin (), starts.end ());
+
+    // Every span has its own slot in end order, so the helices ending on
+    // the same residue are all in the tree.
+    std::sort (byEnd.begin (), byEnd.end ());
+    for (i = 0; i < byEnd.size (); ++i)
+      {
+	slots[byEnd[i].second] = i;
+      }
+    tree.reset (byEnd.size ());
+
+    // The tree holds the ends of the spans started before, the helices
+    // ending within the current span cross it.
+    for (sit = starts.begin (); starts.end () != sit; ++sit)
+      {
+	unsigned int h = sit->second;
+	unsigned int lo = std::lower_bound (byEnd.begin (), byEnd.end (),
+					    make_pair (sit->first, 0u)) - byEnd.begin ();
+	unsigned int hi = std::lower_bound (byEnd.begin (), byEnd.end (),
+					    make_pair (ends[h], 0u)) - byEnd.begin ();
+	unsigned int last = tree.countBelow (hi);
+	unsigned int k;
+
+	for (k = tree.countBelow (lo); k < last; ++k)
+	  {
+	    unsigned int g = byEnd[tree.select (k)].second;
+
+	    crossings.push_back (make_pair (std::min (g, h), std::max (g, h)));
+	  }
+	tree.insert (slots[h]);
+      }
+    std::sort (crossings.begin (), crossings.end ());
+
+    // The crossing helices of each helix, in neighbors[degree[h]] up to
+    // neighbors[degree[h + 1]].
+    for (i = 0; i < crossings.size (); ++i)
+      {
+	++degree[crossings[i].first + 1];
+	++degree[crossings[i].second + 1];
+      }
+    for (i = 1; i < degree.size (); ++i)
+      {
+	degree[i] += degree[i - 1];
+      }
+    neighbors.resize (2 * crossings.size ());
+    {
+      vector< unsigned int > fill (degree.begin (), degree.end () - 1);
+
+      for (i = 0; i < crossings.size (); ++i)
+	{
+	  neighbors[fill[crossings[i].first]++] = crossings[i].second;
+	  neighbors[fill[crossings[i].second]++] = crossings[i].first;
+	}
+    }
+
+    // The orders, from the longest helices down.  The orders taken by the
+    // crossing helices are stamped with the helix index + 1.
+    for (sit = starts.begin (); starts.end () != sit; ++sit)
+      {
+	byLength.push_back (make_pair (0 - (unsigned int) helices[sit->second].size (), sit->second));
+      }
+    std::sort (byLength.begin (), byLength.end ());
+    taken.resize (helices.size () + 1, 0);
+    for (sit = byLength.begin (); byLength.end () != sit; ++sit)
+      {
+	unsigned int h = sit->second;
+	unsigned int o;
+	unsigned int n;
+
+	for (n = degree[h]; n < degree[h + 1]; ++n)
+	  {
+	    unsigned int g = neighbors[n];
+
+	    if (helices[g].size () > helices[h].size ()
+		|| (helices[g].size () == helices[h].size () && g < h))
+	      {
+		taken[helix_order[g]] = h + 1;
+	      }
+	  }
+	for (o = 0; h + 1 == taken[o]; ++o)
+	  ;
+	helix_order[h] = o;
+      }
+  }
+
+
+  void
+  AnnotateModel::dumpPseudoknots (TextWriter &tw) const
+  {
+    vector< pair< unsigned int, unsigned int > >::const_iterator cit;
+    unsigned int maxOrder = 0;
+    unsigned int i;
+
+    for (cit = crossings.begin (); crossings.end () != cit; ++cit)
+      {
+	tw.put ('H').put ((unsigned long) cit->first)
+	  .put (" H").put ((unsigned long) cit->second).endl ();
+      }
+    for (i = 0; i < helix_order.size (); ++i)
+      {
+	if (0 != helix_order[i])
+	  {
+	    tw.put ('H').put ((unsigned long) i)
+	      .put (", order = ").put ((unsigned long) helix_order[i]).endl ();
+	    maxOrder = std::max (maxOrder, helix_order[i]);
+	  }
+      }
+    tw.put ("Number of crossing helices = ").put ((unsigned long) crossings.size ()).endl ();
+    tw.put ("Pseudoknot order = ").put ((unsigned long) maxOrder).endl ();
   }
+
  
   void
-  AnnotateModel::dumpSequences (bool detailed)
+  AnnotateModel::findMultiplets ()
   {
-//   iterator i;
-//   int j = 0;
-//   int currseq = -1;
-//   int size = 0;
-  
-//   if (!detailed) {
-// //    for (i=0; i<(int)conformations.size (); ++i) {
-// //      if (i==0 || sequence_mask[i] != sequence_mask[i-1])
-// //	gOut(0) << " " << setw (8) << getResId (i) << " ";
-// //      gOut(0) << getType (i)->toString ();
-// //    }	
-//     return;
-//   } 
-  
-//   for (i=begin (); i!=end (); ) {
-    
-//     currseq = sequence_mask[(Residue*) &(*i)];
-//     size = sequence_length[currseq];
-
-//     gOut(0) << "Sequence " << currseq << " (length = " 
-// 	 << size << "): " << endl;
-//     int pos = 0;
-//     while (pos < size) 
-//       {
-// 	for (j=pos; (j<size && (j+1)%50!=0); ++j) {
-// 	  if ((j)%50==0) {
-// 	    gOut(0).setf (ios::right, ios::adjustfield);
-// 	    gOut(0) << setw (3) << (*(i+j))->getResId().getChainId ();
-// 	    gOut(0).setf (ios::left, ios::adjustfield);
-// 	    gOut(0) << setw (5) << (*(i+j))->getResId().getResNo () << " ";
-// 	  }
-	  
-// 	  gOut(0) << ((*(i+j))->getType()->isNucleicAcid () ? Pdbstream::stringifyResidueType ((*(i+j))->getType()) : "X");
-	  
-// 	  if ((j+1)%10==0) gOut(0) << " ";
-// 	}
-// 	gOut(0) << endl;
-	
-// 	for (j=pos; (j<sequence_length[currseq] && (j+1)%50!=0); ++j) {
-// 	  if ((j)%50==0) gOut(0) << setw (8) << " " << " ";
-//  	  if (marks.find(*(i+j)) == marks.end()) gOut(0) << "-";
-//           else gOut(0) << marks[*(i+j)];
-// 	  if ((j+1)%10==0) gOut(0) << " ";
-// 	}
-// 	gOut(0) << endl;
-
-// //  	for (j=pos; (j<sequence_length[currseq] && (j+1)%50!=0); ++j) {
-// //  	  if ((j)%50==0)
-// //          gOut(0) << setw (6) << "seq" << " ";
-// //  	  if (sequence_mask[i+j] == -1)
-// //          gOut(0) << "-";
-// //  	  else gOut(0) << sequence_mask[i+j];
-// //  	  if ((j+1)%10==0)
-// //          gOut(0) << " ";
-// //  	}
-// //  	gOut(0) << endl;
-
-//  	for (j=pos; (j<sequence_length[currseq] && (j+1)%50!=0); ++j) {
-//  	  if ((j)%50==0) gOut(0) << setw (8) << "helix" << " ";
-//  	  if (helix_mask.find(*(i+j)) == helix_mask.end()) gOut(0) << "-";
-//  	  else gOut(0) << helix_mask[*(i+j)];
-//  	  if ((j+1)%10==0) gOut(0) << " ";
-//  	}
-//  	gOut(0) << endl;
-
-// //  	for (j=pos; (j<sequence_length[currseq] && (j+1)%50!=0); ++j) {
-// //  	  if ((j)%50==0) gOut(0) << setw (6) << "str" << " ";
-// //  	  if (strand_mask[i+j] == -1) gOut(0) << "-";
-// //  	  else gOut(0) << strand_mask[i+j];
-// //  	  if ((j+1)%10==0) gOut(0) << " ";
-// //  	}
-// //  	gOut(0) << endl;
-
-// // 	for (j=pos; (j<sequence_length[currseq] && (j+1)%50!=0); ++j) {
-// // 	  if ((j)%50==0) gOut(0) << setw (6) << "ter" << " ";
-// // 	  if (tertiary_mask[i+j] == -1) gOut(0) << "-";
-// // 	  else gOut(0) << 'X';
-// // 	  if ((j+1)%10==0) gOut(0) << " ";
-// // 	}
-
-// // 	gOut(0) << endl << endl;
-
-// 	pos = j+1;
-//       }
-//     i += pos-1;
-//   }
-//   gOut(0).setf (ios::left, ios::adjustfield);
+    // The multiplet of a set without any.
+    static const unsigned int NONE = 0xffffffff;
+    vector< unsigned int > root (size ());
+    vector< unsigned int > count (size (), 0);
+    vector< unsigned int > multiplet (size (), NONE);
+    vector< BasePair >::const_iterator bit;
+    unsigned int row;
+    unsigned int l;
+
+    multiplets.clear ();
+    for (l = 0; l < root.size (); ++l)
+      {
+	root[l] = l;
+      }
+    for (bit = basepairs.begin (); basepairs.end () != bit; ++bit)
+      {
+	unsigned int a = findRoot (root, bit->first);
+	unsigned int b = findRoot (root, bit->second);
+
+	if (a != b)
+	  {
+	    root[std::max (a, b)] = std::min (a, b);
+	  }
+      }
+
+    // The size of each set, then the multiplets in the order of their
+    // first residue.
+    for (l = 0; l < root.size (); ++l)
+      {
+	++count[findRoot (root, l)];
+      }
+    for (l = 0; l < root.size (); ++l)
+      {
+	unsigned int r = findRoot (root, l);
+
+	if (3 <= count[r])
+	  {
+	    if (NONE == multiplet[r])
+	      {
+		multiplet[r] = multiplets.size ();
+		multiplets.push_back (Multiplet ());
+	      }
+	    multiplets[multiplet[r]].addResidue (l);
+	  }
+      }
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	if (relationTable.is (row, RelationTable::PAIR))
+	  {
+	    unsigned int m = multiplet[findRoot (root, relationTable.getRef (row))];
+
+	    if (NONE != m)
+	      {
+		multiplets[m].addRow (row);
+	      }
+	  }
+      }
   }
 
-  
+
+  unsigned int
+  AnnotateModel::findRoot (vector< unsigned int > &root, unsigned int l)
+  {
+    // Path halving.
+    while (root[l] != l)
+      {
+	root[l] = root[root[l]];
+	l = root[l];
+      }
+    return l;
+  }
+
+
   void
-  AnnotateModel::dumpConformations () const
+  AnnotateModel::buildDotBracket ()
   {
-    const_iterator i;
-    
-    for (i = begin (); i != end (); ++i)
+    static const char PAGES[] = "()[]{}<>";
+    vector< NestedPairs::Arc > arcs;
+    vector< NestedPairs::Arc > nested;
+    vector< NestedPairs::Arc > rest;
+    vector< NestedPairs::Arc >::const_iterator ait;
+    vector< BasePair >::const_iterator bit;
+    NestedPairs solver (sequences.getNbIds ());
+    unsigned int page;
+
+    for (bit = basepairs.begin (); basepairs.end () != bit; ++bit)
       {
-	gOut(0) << i->getResId ()
-		<< " : " << Pdbstream::stringifyResidueType (i->getType ());
-	if (i->getType ()->isNucleicAcid ())
+	if (isHelixPairing (bit->labels)
+	    && -1 != sequence_mask[bit->first]
+	    && sequence_mask[bit->first] == sequence_mask[bit->second])
+	  {
+	    unsigned int a = sequence_rank[bit->first];
+	    unsigned int b = sequence_rank[bit->second];
+
+	    arcs.push_back (make_pair (std::min (a, b), std::max (a, b)));
+	  }
+      }
+    std::sort (arcs.begin (), arcs.end ());
+    arcs.erase (std::unique (arcs.begin (), arcs.end ()), arcs.end ());
+
+    dot_bracket.assign (sequences.getNbIds (), '.');
+    for (page = 0; 2 * page < sizeof (PAGES) - 1 && ! arcs.empty (); ++page)
+      {
+	solver.split (arcs, nested, rest);
+	for (ait = nested.begin (); nested.end () != ait; ++ait)
+	  {
+	    dot_bracket[ait->first] = PAGES[2 * page];
+	    dot_bracket[ait->second] = PAGES[2 * page + 1];
+	  }
+	arcs.clear ();
+	for (ait = rest.begin (); rest.end () != ait; ++ait)
+	  {
+	    if ('.' == dot_bracket[ait->first] && '.' == dot_bracket[ait->second])
+	      {
+		arcs.push_back (*ait);
+	      }
+	  }
+      }
+    nbUnpaged = arcs.size ();
+  }
+
+
+  void
+  AnnotateModel::dumpDotBracket (TextWriter &tw, const vector< string > &resIds) const
+  {
+    StrandSet::const_iterator sit;
+    unsigned int base;
+
+    for (sit = sequences.begin (), base = 0; sequences.end () != sit; base += (sit++)->size ())
+      {
+	Strand::const_iterator rit;
+
+	tw.putRight (resIds[sequences.getLabel (base)], 8).put (' ');
+	for (rit = sit->begin (); sit->end () != rit; ++rit)
+	  {
+	    const ResidueType *type = (*rit)->getType ();
+
+	    tw.put (type->isNucleicAcid () ? Pdbstream::stringifyResidueType (type) : "X");
+	  }
+	tw.endl ().put ("         ").write (dot_bracket.data () + base, sit->size ()).endl ();
+      }
+    if (0 != nbUnpaged)
+      {
+	tw.put ("Number of unpaged helix pairs = ").put ((unsigned long) nbUnpaged).endl ();
+      }
+  }
+
+
+  void
+  AnnotateModel::dumpSequences (TextWriter &tw, const vector< string > &resIds,
+				bool detailed) const
+  {
+    static const unsigned int LINE = 50;
+    static const unsigned int BLOCK = 10;
+    StrandSet::const_iterator sit;
+    unsigned int base;
+
+    // The sequential ids of a strand follow those of the previous one.
+    for (sit = sequences.begin (), base = 0; sequences.end () != sit; base += (sit++)->size ())
+      {
+	const Strand &strand = *sit;
+	unsigned int pos;
+	unsigned int j;
+
+	if (! detailed)
 	  {
-	    gOut (0) << " " << i->getPucker ()
-		     << " " << i->getGlycosyl ();
+	    tw.putRight (resIds[sequences.getLabel (base)], 8).put (' ');
+	    for (j = 0; j < strand.size (); ++j)
+	      {
+		const ResidueType *type = strand[j]->getType ();
+
+		tw.put (type->isNucleicAcid () ? Pdbstream::stringifyResidueType (type) : "X");
+	      }
+	    tw.endl ();
+	    continue;
+	  }
+
+	tw.put ("Sequence ").put ((unsigned long) (sit - sequences.begin ()))
+	  .put (" (length = ").put ((unsigned long) strand.size ()).put ("): ").endl ();
+	for (pos = 0; pos < strand.size (); pos += LINE)
+	  {
+	    unsigned int end = std::min (pos + LINE, (unsigned int) strand.size ());
+	    const ResId &first = strand[pos]->getResId ();
+	    ostringstream number;
+
+	    number << first.getResNo ();
+	    tw.putRight (string (1, first.getChainId ()), 3).put (number.str ());
+	    for (j = number.str ().size (); j < 6; ++j)
+	      {
+		tw.put (' ');
+	      }
+	    for (j = pos; j < end; ++j)
+	      {
+		const ResidueType *type = strand[j]->getType ();
+
+		tw.put (type->isNucleicAcid () ? Pdbstream::stringifyResidueType (type) : "X");
+		if (0 == (j + 1 - pos) % BLOCK)
+		  {
+		    tw.put (' ');
+		  }
+	      }
+	    tw.endl ();
+
+	    tw.put ("         ");
+	    for (j = pos; j < end; ++j)
+	      {
+		unsigned int mark = marks[sequences.getLabel (base + j)];
+
+		tw.put (0 != (mark & LHELIX) ? '(' : 0 != (mark & RHELIX) ? ')' : '-');
+		if (0 == (j + 1 - pos) % BLOCK)
+		  {
+		    tw.put (' ');
+		  }
+	      }
+	    tw.endl ();
+
+	    tw.put ("   helix ");
+	    for (j = pos; j < end; ++j)
+	      {
+		int helix = helix_mask[sequences.getLabel (base + j)];
+
+		tw.put (-1 == helix ? '-' : (char) ('0' + helix % 10));
+		if (0 == (j + 1 - pos) % BLOCK)
+		  {
+		    tw.put (' ');
+		  }
+	      }
+	    tw.endl ();
 	  }
-	gOut (0) << endl;
       }
   }
 
+
   
   void
-  AnnotateModel::dumpStacks () const
+  AnnotateModel::formatResIds (vector< string > &resIds) const
   {
-    vector< BaseStack > nonAdjacentStacks;
-    vector< BaseStack >::const_iterator bsit;
+    label l;
+
+    resIds.resize (size ());
+    for (l = 0; l < (label) size (); ++l)
+      {
+	ostringstream oss;
+
+	oss << internalGetVertex (l)->getResId ();
+	resIds[l] = oss.str ();
+      }
+  }
 
-    gOut(0) << "Adjacent stackings ----------------------------------------------" << endl;
 
-    for (bsit = stacks.begin (); stacks.end () != bsit; ++bsit)
+  void
+  AnnotateModel::dumpLabels (TextWriter &tw, const LabelSet &labels, const LabelOrder &order)
+  {
+    LabelOrder::const_iterator lit;
+
+    for (lit = order.begin (); order.end () != lit; ++lit)
       {
-	const Relation *rel = internalGetEdge (bsit->first, bsit->second);
-	if (rel->is (PropertyType::pAdjacent))
+	if (labels.test (lit->second))
 	  {
-	    const set< const PropertyType* > &labels = rel->getLabels ();
+	    tw.put (lit->first).put (' ');
+	  }
+      }
+  }
 
-	    gOut (0) << bsit->fResId << "-" << bsit->rResId << " : ";
-	    copy (labels.begin (), labels.end (), ostream_iterator< const PropertyType* > (gOut (0), " "));
-	    gOut (0) << endl;
+
+  void
+  AnnotateModel::dumpConformations (TextWriter &tw, const vector< string > &resIds) const
+  {
+    const_iterator i;
+    label l;
+
+    for (i = begin (), l = 0; i != end (); ++i, ++l)
+      {
+	tw.put (resIds[l])
+	  .put (" : ").put (Pdbstream::stringifyResidueType (i->getType ()));
+	if (i->getType ()->isNucleicAcid ())
+	  {
+	    tw.put (' ').put (i->getPucker ())
+	      .put (' ').put (i->getGlycosyl ());
 	  }
-	else
+	tw.endl ();
+      }
+  }
+
+  
+  void
+  AnnotateModel::dumpStacks (TextWriter &tw, const vector< string > &resIds,
+			     const LabelOrder &order) const
+  {
+    vector< unsigned int > nonAdjacentStacks;
+    vector< unsigned int >::const_iterator nit;
+    unsigned int nbStacks = 0;
+    unsigned int i;
+
+    tw.put ("Adjacent stackings ----------------------------------------------").endl ();
+
+    for (i = 0; i < relationTable.size (); ++i)
+      {
+	if (relationTable.is (i, RelationTable::STACK))
 	  {
-	    nonAdjacentStacks.push_back (*bsit);
+	    ++nbStacks;
+	    if (relationTable.getLabels (i).intersects (adjacentMask))
+	      {
+		tw.put (resIds[relationTable.getRef (i)]).put ('-')
+		  .put (resIds[relationTable.getRes (i)]).put (" : ");
+		dumpLabels (tw, relationTable.getLabels (i), order);
+		tw.endl ();
+	      }
+	    else
+	      {
+		nonAdjacentStacks.push_back (i);
+	      }
 	  }
       }
     
-    gOut(0) << "Non-Adjacent stackings ------------------------------------------" << endl;
+    tw.put ("Non-Adjacent stackings ------------------------------------------").endl ();
     
-    for (bsit = nonAdjacentStacks.begin (); nonAdjacentStacks.end () != bsit; ++bsit)
+    for (nit = nonAdjacentStacks.begin (); nonAdjacentStacks.end () != nit; ++nit)
       {
-	const set< const PropertyType* > &labels = internalGetEdge (bsit->first, bsit->second)->getLabels ();
-	
-	gOut (0) << bsit->fResId << "-" << bsit->rResId << " : ";
-	copy (labels.begin (), labels.end (), ostream_iterator< const PropertyType* > (gOut (0), " "));
-	gOut (0) << endl;
+	tw.put (resIds[relationTable.getRef (*nit)]).put ('-')
+	  .put (resIds[relationTable.getRes (*nit)]).put (" : ");
+	dumpLabels (tw, relationTable.getLabels (*nit), order);
+	tw.endl ();
       }
 
-    gOut(0) << "Number of stackings = " << stacks.size () << endl
-// 	    << "Number of helical stackings = " << nb_helical_stacks << endl
-	    << "Number of adjacent stackings = " << stacks.size () - nonAdjacentStacks.size () << endl
-	    << "Number of non adjacent stackings = " << nonAdjacentStacks.size () << endl;
+    tw.put ("Number of stackings = ").put ((unsigned long) nbStacks).endl ()
+//       .put ("Number of helical stackings = ").put (nb_helical_stacks).endl ()
+      .put ("Number of adjacent stackings = ").put ((unsigned long) (nbStacks - nonAdjacentStacks.size ())).endl ()
+      .put ("Number of non adjacent stackings = ").put ((unsigned long) nonAdjacentStacks.size ()).endl ();
   }
   
 
   void
-  AnnotateModel::dumpPairs () const
+  AnnotateModel::dumpPairs (TextWriter &tw, const vector< string > &resIds,
+			    const LabelOrder &order) const
   {
-    vector< BasePair >::const_iterator bpit;
+    unsigned int i;
 
-    for (bpit = basepairs.begin (); basepairs.end () != bpit; ++bpit)
+    for (i = 0; i < relationTable.size (); ++i)
       {
-	const Relation &rel = *internalGetEdge (bpit->first, bpit->second);
-	const set< const PropertyType* > &labels = rel.getLabels ();
-	const vector< pair< const PropertyType*, const PropertyType* > > &faces = rel.getPairedFaces ();
-	vector< pair< const PropertyType*, const PropertyType* > >::const_iterator pfit;
-
-	gOut(0) << bpit->fResId << '-' << bpit->rResId << " : ";
-	gOut(0) << Pdbstream::stringifyResidueType (rel.getRef ()->getType())
-		<< "-"
-		<< Pdbstream::stringifyResidueType (rel.getRes ()->getType ())
-		<< " ";
-	for (pfit = faces.begin (); faces.end () != pfit; ++pfit)
+	if (relationTable.is (i, RelationTable::PAIR))
 	  {
-	    gOut (0) << *pfit->first << "/" << *pfit->second << ' ';
+	    dumpPair (tw, i, resIds, order);
 	  }
-	copy (labels.begin (), labels.end (), ostream_iterator< const PropertyType* > (gOut (0), " "));
-	gOut (0) << endl;
       }
   }
 
+
+  void
+  AnnotateModel::dumpPair (TextWriter &tw, unsigned int row, const vector< string > &resIds,
+			   const LabelOrder &order) const
+  {
+    label ref = relationTable.getRef (row);
+    label res = relationTable.getRes (row);
+    const RelationTable::Face *fit;
+
+    tw.put (resIds[ref]).put ('-').put (resIds[res]).put (" : ");
+    tw.put (Pdbstream::stringifyResidueType (internalGetVertex (ref)->getType()))
+      .put ('-')
+      .put (Pdbstream::stringifyResidueType (internalGetVertex (res)->getType ()))
+      .put (' ');
+    for (fit = relationTable.getFacesBegin (row); relationTable.getFacesEnd (row) != fit; ++fit)
+      {
+	tw.put (fit->first).put ('/').put (fit->second).put (' ');
+      }
+    dumpLabels (tw, relationTable.getLabels (row), order);
+    tw.endl ();
+  }
+
   
   void
-  AnnotateModel::dumpTriples ()
+  AnnotateModel::dumpMultiplets (TextWriter &tw, const vector< string > &resIds,
+				 const LabelOrder &order) const
   {
-//     const_iterator gi;
-//     list< Residue* > neighbor;
-//     list< Residue* >::iterator nborIt;
-
-//     int count;
-//     int nb = 1;
-//     set< node > nodes;
-//     set< node >::iterator k, l;
-//     vector< bool > treated;
-
-//     treated.resize (size (), false);
-
-//     for (gi=begin (); gi!=end (); ++gi) {
-//       count = 0;
-//       nodes.clear ();
-//       if (!treated[*gi]) {
-// 	nodes.insert (*gi);
-      
-// 	neighbor = getNeighbors (*gi);
+    vector< Multiplet >::const_iterator mit;
 
-// 	for (nborIt=neighbor.begin (); nborIt!=neighbor.end (); ++nborIt) {
-// 	  if (isPairing (getEdge (*gi,*nborIt))) {
-// 	    count++;
-// 	    nodes.insert (*nborIt);
-// 	  }
-// 	}
-// 	if (count > 1) {
-// 	  gOut(0).setf (ios::left, ios::adjustfield);
-// 	  gOut(0) << "T" << setw (5) << nb++ << " "; 
-// 	  for (k=nodes.begin (); k!=nodes.end (); ++k) {	
-// 	    for (l=k; l!=nodes.end (); ++l) {
-// 	      if (k!=l && isPairing (*k, *l)) {
-// 		gOut(0) << getResId (*k) << "-"
-// 			<< getResId (*l) << " ";
-// 		treated[*k] = true;
-// 		treated[*l] = true;
-// 	      }
-// 	    }
-// 	  }
-// 	  gOut(0) << endl;
-// 	}
-//       }
-//     }
-//     gOut(0).setf (ios::left, ios::adjustfield);
+    for (mit = multiplets.begin (); multiplets.end () != mit; ++mit)
+      {
+	const vector< unsigned int > &residues = mit->getResidues ();
+	const vector< unsigned int > &rows = mit->getRows ();
+	unsigned int i;
+
+	tw.put ('M').put ((unsigned long) (mit - multiplets.begin ()))
+	  .put (", size = ").put ((unsigned long) residues.size ()).put (" :");
+	for (i = 0; i < residues.size (); ++i)
+	  {
+	    tw.put (' ').put (resIds[residues[i]]);
+	  }
+	tw.endl ();
+	for (i = 0; i < rows.size (); ++i)
+	  {
+	    tw.put ("  ");
+	    dumpPair (tw, rows[i], resIds, order);
+	  }
+      }
   }
 
   ostream&
   AnnotateModel::output (ostream &os) const
   {
-    gOut (0) << "Residue conformations -------------------------------------------" << endl;
-    dumpConformations ();
-    dumpStacks ();
-    gOut (0) << "Base-pairs ------------------------------------------------------" << endl;
-// //     findKissingHairpins ();
-    dumpPairs ();
-//     gOut (0) << "Triples ---------------------------------------------------------" << endl;
-// //     dumpTriples ();
-//     gOut (0) << "Helices ---------------------------------------------------------" << endl;
-//     dumpHelices ();
-//     gOut (0) << "Strands ---------------------------------------------------------" << endl;
-//     dumpStrands ();
-//     gOut (0) << "Various features ------------------------------------------------" << endl;
-// //     findPseudoknots ();
-//     gOut (0) << "Sequences -------------------------------------------------------" << endl;
-// //     dumpSequences ();
+    TextWriter tw (os);
+    vector< string > resIds;
+    LabelOrder order;
+
+    formatResIds (resIds);
+    LabelTable::getOrder (order);
+    tw.put ("Residue conformations -------------------------------------------").endl ();
+    dumpConformations (tw, resIds);
+    dumpStacks (tw, resIds, order);
+    tw.put ("Base-pairs ------------------------------------------------------").endl ();
+    dumpPairs (tw, resIds, order);
+    tw.put ("Multiplets ------------------------------------------------------").endl ();
+    dumpMultiplets (tw, resIds, order);
+    tw.put ("Helices ---------------------------------------------------------").endl ();
+    dumpHelices (tw, resIds);
+    tw.put ("Loops -----------------------------------------------------------").endl ();
+    dumpLoops (tw, resIds);
+    tw.put ("Tertiary interactions -------------------------------------------").endl ();
+    dumpTertiaries (tw, resIds, order);
+    tw.put ("Pseudoknots -----------------------------------------------------").endl ();
+    dumpPseudoknots (tw);
+    tw.put ("Sequences -------------------------------------------------------").endl ();
+    dumpSequences (tw, resIds);
+    tw.put ("Dot-bracket -----------------------------------------------------").endl ();
+    dumpDotBracket (tw, resIds);
 //     gOut (0) << endl;
     return os;
   }
 
 
+  void
+  AnnotateModel::dumpJsonRelation (TextWriter &tw, const string &head, const char *type,
+				    unsigned int row, const vector< string > &resIds,
+				    const LabelOrder &order) const
+  {
+    const LabelSet &labels = relationTable.getLabels (row);
+    label ref = relationTable.getRef (row);
+    label res = relationTable.getRes (row);
+
+    tw.put (head).put ("\"type\":\"").put (type).put ("\",\"fResId\":").putQuoted (resIds[ref])
+      .put (",\"rResId\":").putQuoted (resIds[res])
+      .put (",\"fType\":").putQuoted (Pdbstream::stringifyResidueType (internalGetVertex (ref)->getType ()))
+      .put (",\"rType\":").putQuoted (Pdbstream::stringifyResidueType (internalGetVertex (res)->getType ()));
+    if (labels.intersects (pairingMask))
+      {
+	const RelationTable::Face *fit;
+
+	tw.put (",\"faces\":[");
+	for (fit = relationTable.getFacesBegin (row); relationTable.getFacesEnd (row) != fit; ++fit)
+	  {
+	    if (relationTable.getFacesBegin (row) != fit)
+	      {
+		tw.put (',');
+	      }
+	    tw.put ('[').putQuoted (fit->first).put (',').putQuoted (fit->second).put (']');
+	  }
+	tw.put (']');
+      }
+    if (labels.intersects (stackMask))
+      {
+	tw.put (",\"adjacent\":").put (labels.intersects (adjacentMask) ? "true" : "false");
+      }
+    dumpJsonLabels (tw, labels, order);
+    tw.put ('}').endl ();
+  }
+
+
+  void
+  AnnotateModel::dumpJsonLabels (TextWriter &tw, const LabelSet &labels, const LabelOrder &order)
+  {
+    LabelOrder::const_iterator lit;
+    bool first = true;
+
+    tw.put (",\"labels\":[");
+    for (lit = order.begin (); order.end () != lit; ++lit)
+      {
+	if (labels.test (lit->second))
+	  {
+	    if (! first)
+	      {
+		tw.put (',');
+	      }
+	    tw.putQuoted (lit->first);
+	    first = false;
+	  }
+      }
+    tw.put (']');
+  }
+
+
+  ostream&
+  AnnotateModel::outputJsonl (ostream &os, const string &file, unsigned int model) const
+  {
+    TextWriter tw (os);
+    vector< string > resIds;
+    string head;
+    const_iterator i;
+    label l;
+    unsigned int row;
+    LabelOrder order;
+
+    formatResIds (resIds);
+    LabelTable::getOrder (order);
+    {
+      ostringstream oss;
+      TextWriter hw (oss);
+
+      hw.put ("{\"file\":").putQuoted (file).put (",\"model\":").put ((unsigned long) model).put (',');
+      hw.flush ();
+      head = oss.str ();
+    }
+    for (i = begin (), l = 0; i != end (); ++i, ++l)
+      {
+	tw.put (head).put ("\"type\":\"residue\",\"resId\":").putQuoted (resIds[l])
+	  .put (",\"resType\":").putQuoted (Pdbstream::stringifyResidueType (i->getType ()));
+	if (i->getType ()->isNucleicAcid ())
+	  {
+	    tw.put (",\"pucker\":").putQuoted (i->getPucker ())
+	      .put (",\"glycosyl\":").putQuoted (i->getGlycosyl ());
+	  }
+	tw.put ('}').endl ();
+      }
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	if (relationTable.is (row, RelationTable::STACK))
+	  {
+	    dumpJsonRelation (tw, head, "stack", row, resIds, order);
+	  }
+      }
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	if (relationTable.is (row, RelationTable::LINK))
+	  {
+	    dumpJsonRelation (tw, head, "link", row, resIds, order);
+	  }
+      }
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	if (relationTable.is (row, RelationTable::PAIR))
+	  {
+	    dumpJsonRelation (tw, head, "pair", row, resIds, order);
+	  }
+      }
+    for (row = 0; row < multiplets.size (); ++row)
+      {
+	const vector< unsigned int > &residues = multiplets[row].getResidues ();
+	unsigned int j;
+
+	tw.put (head).put ("\"type\":\"multiplet\",\"resIds\":[");
+	for (j = 0; j < residues.size (); ++j)
+	  {
+	    (0 == j ? tw : tw.put (',')).putQuoted (resIds[residues[j]]);
+	  }
+	tw.put ("]}").endl ();
+      }
+    for (row = 0; row < crossings.size (); ++row)
+      {
+	unsigned int f = crossings[row].first;
+	unsigned int r = crossings[row].second;
+
+	tw.put (head).put ("\"type\":\"crossing\",\"fHelix\":").put ((unsigned long) f)
+	  .put (",\"rHelix\":").put ((unsigned long) r)
+	  .put (",\"fOrder\":").put ((unsigned long) helix_order[f])
+	  .put (",\"rOrder\":").put ((unsigned long) helix_order[r]).put ('}').endl ();
+      }
+    {
+      StrandSet::const_iterator sit;
+      unsigned int base;
+
+      for (sit = sequences.begin (), base = 0; sequences.end () != sit; base += (sit++)->size ())
+	{
+	  Strand::const_iterator rit;
+	  string sequence;
+
+	  for (rit = sit->begin (); sit->end () != rit; ++rit)
+	    {
+	      const ResidueType *type = (*rit)->getType ();
+
+	      sequence += type->isNucleicAcid () ? Pdbstream::stringifyResidueType (type) : "X";
+	    }
+	  tw.put (head).put ("\"type\":\"structure\",\"resId\":").putQuoted (resIds[sequences.getLabel (base)])
+	    .put (",\"sequence\":").putQuoted (sequence)
+	    .put (",\"dotBracket\":").putQuoted (dot_bracket.substr (base, sit->size ())).put ('}').endl ();
+	}
+    }
+    return os;
+  }
+
+
+  void
+  AnnotateModel::outputBinary (BinaryWriter &bw, unsigned int model) const
+  {
+    vector< string > resIds;
+    const_iterator i;
+    label l;
+    unsigned int row;
+    LabelOrder order;
+
+    formatResIds (resIds);
+    LabelTable::getOrder (order);
+    bw.beginModel (model);
+    for (i = begin (), l = 0; i != end (); ++i, ++l)
+      {
+	bw.addResidue (resIds[l], Pdbstream::stringifyResidueType (i->getType ()),
+		       i->getType ()->isNucleicAcid (), i->getPucker (), i->getGlycosyl ());
+      }
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	if (relationTable.is (row, RelationTable::STACK))
+	  {
+	    bw.addRelation (BINARY_STACK, relationTable, row, order);
+	  }
+      }
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	if (relationTable.is (row, RelationTable::LINK))
+	  {
+	    bw.addRelation (BINARY_LINK, relationTable, row, order);
+	  }
+      }
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	if (relationTable.is (row, RelationTable::PAIR))
+	  {
+	    bw.addRelation (BINARY_PAIR, relationTable, row, order);
+	  }
+      }
+    bw.endModel ();
+  }
+
+
   iPdbstream&
   AnnotateModel::input (iPdbstream &is)
   {
@@ -1071,23 +1880,204 @@ namespace annotate
     return GraphModel::input (is);
   }
   
-//   oBinstream&
-//   AnnotateModel::output (oBinstream &os) const
-//   {
-//     return os;
-//   }
- 
-//   iBinstream&
-//   operator>> (iBinstream &is, AnnotateModel &model)
-//   {
-//     return model.input (is);
-//   }
 
-//   oBinstream&
-//   operator<< (oBinstream &os, const AnnotateModel &model)
-//   {
-//     return model.output (os);
-//   }
+  oBinstream&
+  AnnotateModel::writeSnapshot (oBinstream &obs) const
+  {
+    map< const PropertyType*, unsigned int > index;
+    map< const PropertyType*, unsigned int >::iterator it;
+    vector< const PropertyType* > names;
+    vector< const PropertyType* >::iterator nit;
+    LabelOrder order;
+    LabelOrder::iterator lit;
+    const RelationTable::Face *fit;
+    unsigned int row;
+
+    GraphModel::output (obs);
+
+    // The name dictionary holds the labels and the faces of the rows.
+    LabelTable::getOrder (order);
+    for (lit = order.begin (); order.end () != lit; ++lit)
+      {
+	index.insert (make_pair (lit->first, (unsigned int) names.size ()));
+	names.push_back (lit->first);
+      }
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	for (fit = relationTable.getFacesBegin (row); relationTable.getFacesEnd (row) != fit; ++fit)
+	  {
+	    if (index.insert (make_pair (fit->first, (unsigned int) names.size ())).second)
+	      {
+		names.push_back (fit->first);
+	      }
+	    if (index.insert (make_pair (fit->second, (unsigned int) names.size ())).second)
+	      {
+		names.push_back (fit->second);
+	      }
+	  }
+      }
+    obs << (unsigned int) names.size ();
+    for (nit = names.begin (); names.end () != nit; ++nit)
+      {
+	writeName (obs, *nit);
+      }
+
+    obs << relationTable.size ();
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	const LabelSet &labels = relationTable.getLabels (row);
+	uint64_t key = relationTable.getKey (row);
+	unsigned int nbLabels = 0;
+
+	for (lit = order.begin (); order.end () != lit; ++lit)
+	  {
+	    nbLabels += labels.test (lit->second) ? 1 : 0;
+	  }
+	obs << (unsigned int) relationTable.getKind (row)
+	    << (unsigned int) relationTable.getRef (row)
+	    << (unsigned int) relationTable.getRes (row)
+	    << (unsigned int) (key >> 32)
+	    << (unsigned int) (key & 0xffffffff)
+	    << nbLabels;
+	for (lit = order.begin (); order.end () != lit; ++lit)
+	  {
+	    if (labels.test (lit->second))
+	      {
+		obs << index[lit->first];
+	      }
+	  }
+	obs << (unsigned int) (relationTable.getFacesEnd (row) - relationTable.getFacesBegin (row));
+	for (fit = relationTable.getFacesBegin (row); relationTable.getFacesEnd (row) != fit; ++fit)
+	  {
+	    obs << index[fit->first] << index[fit->second];
+	  }
+      }
+    return obs;
+  }
+
+
+  iBinstream&
+  AnnotateModel::readSnapshot (iBinstream &is)
+  {
+    vector< const PropertyType* > names;
+    vector< LabelSet > masks;
+    vector< bool > known;
+    vector< RelationTable::Face > faces;
+    vector< AdjacencyTable::Edge > edges;
+    unsigned int nbNames;
+    unsigned int nbRows;
+    unsigned int row;
+    unsigned int i;
+
+    GraphModel::input (is);
+    basepairs.clear ();
+    stacks.clear ();
+    links.clear ();
+    relationTable.clear ();
+    adjacency.clear ();
+    marks.assign (size (), 0);
+    nbPairs = 0;
+    nbCandidates = 0;
+
+    is >> nbNames;
+    for (i = 0; i < nbNames && is.good (); ++i)
+      {
+	names.push_back (PropertyType::parseType (readName (is)));
+      }
+    // A name only gets a label id when a row uses it as a label.
+    masks.resize (names.size ());
+    known.resize (names.size (), false);
+
+    is >> nbRows;
+    relationTable.reserve (nbRows);
+    for (row = 0; row < nbRows && is.good (); ++row)
+      {
+	unsigned int kind, ref, res, high, low, nb, name, first, second;
+	LabelSet labels;
+
+	is >> kind >> ref >> res >> high >> low >> nb;
+	if (ref >= size () || res >= size ())
+	  {
+	    break;
+	  }
+	for (i = 0; i < nb; ++i)
+	  {
+	    is >> name;
+	    if (name >= names.size ())
+	      {
+		break;
+	      }
+	    if (! known[name])
+	      {
+		masks[name].set (LabelTable::getId (names[name]));
+		known[name] = true;
+	      }
+	    labels = labels | masks[name];
+	  }
+	if (i < nb)
+	  {
+	    break;
+	  }
+	faces.clear ();
+	is >> nb;
+	for (i = 0; i < nb; ++i)
+	  {
+	    is >> first >> second;
+	    if (first >= names.size () || second >= names.size ())
+	      {
+		break;
+	      }
+	    faces.push_back (make_pair (names[first], names[second]));
+	  }
+	if (i < nb)
+	  {
+	    break;
+	  }
+	relationTable.push_back (kind, ref, res, (uint64_t) high << 32 | low, labels, 0, faces);
+      }
+    if (row < nbRows || ! is.good ())
+      {
+	FatalIntLibException ex ("", __FILE__, __LINE__);
+
+	ex << "corrupted annotation snapshot.";
+	throw ex;
+      }
+    // The edges of the rows, both ways, for the structure searches.
+    edges.reserve (2 * relationTable.size ());
+    for (row = 0; row < relationTable.size (); ++row)
+      {
+	AdjacencyTable::Edge e;
+
+	e.from = relationTable.getRef (row);
+	e.to = relationTable.getRes (row);
+	e.relation = 0;
+	edges.push_back (e);
+	std::swap (e.from, e.to);
+	edges.push_back (e);
+      }
+    adjacency.build (size (), edges);
+    fillRecords ();
+    findStructures ();
+    return is;
+  }
+
+
+  void
+  AnnotateModel::writeSnapshotHeader (oBinstream &obs)
+  {
+    obs << SNAPSHOT_MAGIC << SNAPSHOT_VERSION;
+  }
+
+
+  unsigned int
+  AnnotateModel::readSnapshotHeader (iBinstream &is)
+  {
+    unsigned int magic = 0;
+    unsigned int version = 0;
+
+    is >> magic >> version;
+    return is.good () && SNAPSHOT_MAGIC == magic ? version : 0;
+  }
 
 }
 
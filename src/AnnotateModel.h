@@ -28,10 +28,19 @@
 #include "mccore/Residue.h"
 #include "mccore/ResidueType.h"
 
+#include "AdjacencyTable.h"
 #include "BaseLink.h"
 #include "BasePair.h"
 #include "BaseStack.h"
+#include "BinaryWriter.h"
 #include "Helix.h"
+#include "LabelTable.h"
+#include "Multiplet.h"
+#include "NeighborList.h"
+#include "RelationTable.h"
+#include "ResidueGrid.h"
+#include "SphereTable.h"
+#include "TextWriter.h"
 
 using namespace mccore;
 using namespace std;
@@ -42,6 +51,7 @@ namespace mccore
 {
   class iBinstream;
   class iPdbstream;
+  class oBinstream;
 }
 
 
@@ -52,7 +62,7 @@ namespace annotate
   
   typedef int strandId;
   
-  enum stype { BULGE_OUT, BULGE, INTERNAL_LOOP, LOOP, HELIX, OTHER };
+  enum stype { BULGE_OUT, BULGE, INTERNAL_LOOP, LOOP, HELIX, OTHER, JUNCTION };
  
   class Strand : public vector< const Residue* >
   {
@@ -85,9 +95,52 @@ namespace annotate
   {
     /**
      * Map from integer to original ResId.  The ResId of the residues are
-     * replaced with sequential ids.
+     * replaced with sequential ids, their position in the strands put end
+     * to end, so the map is indexed by the id.
      */
-    map< unsigned int, const ResId * > int2ResIdMap;
+    vector< const ResId* > int2ResIdMap;
+
+    /**
+     * The vertex label of each sequential id.
+     */
+    vector< GraphModel::label > int2LabelMap;
+
+  public:
+
+    void clear ()
+    {
+      vector< Strand >::clear ();
+      int2ResIdMap.clear ();
+      int2LabelMap.clear ();
+    }
+
+    /**
+     * Gives the next sequential id to a residue.
+     * @param resId the original residue id.
+     * @param l the vertex label of the residue.
+     * @return the sequential id.
+     */
+    unsigned int addResId (const ResId *resId, GraphModel::label l)
+    {
+      int2ResIdMap.push_back (resId);
+      int2LabelMap.push_back (l);
+      return int2ResIdMap.size () - 1;
+    }
+
+    /**
+     * Gets the original residue id of a sequential id.
+     */
+    const ResId* getResId (unsigned int id) const { return int2ResIdMap[id]; }
+
+    /**
+     * Gets the vertex label of a sequential id.
+     */
+    GraphModel::label getLabel (unsigned int id) const { return int2LabelMap[id]; }
+
+    /**
+     * Gets the number of sequential ids.
+     */
+    unsigned int getNbIds () const { return int2LabelMap.size (); }
       
   };
 
@@ -113,6 +166,16 @@ namespace annotate
      */
     unsigned int environment;
 
+    /**
+     * The edge length of the spatial grid cells, 0 for automatic.
+     */
+    float cellSize;
+
+    /**
+     * The number of threads computing the relations of a model.
+     */
+    unsigned int nbThreads;
+
   public:
 
     // LIFECYCLE ------------------------------------------------------------
@@ -127,14 +190,21 @@ namespace annotate
     AnnotateModelFM (const ResIdSet &rs, unsigned int env, const ResidueFactoryMethod *fm = 0)
       : ModelFactoryMethod (fm),
 	residueSelection (rs),
-	environment (env)
+	environment (env),
+	cellSize (0),
+	nbThreads (1)
     { }
 
     /**
      * Initializes the object with the right content.
      * @param right the object to copy.
      */
-    AnnotateModelFM (const ModelFM &right) : ModelFactoryMethod (right) { }
+    AnnotateModelFM (const ModelFM &right)
+      : ModelFactoryMethod (right),
+	environment (0),
+	cellSize (0),
+	nbThreads (1)
+    { }
 
     /**
      * Clones the object.
@@ -154,6 +224,19 @@ namespace annotate
 
     // ACCESS ---------------------------------------------------------------
 
+    /**
+     * Sets the spatial grid cell size of the created models.
+     * @param size the cell edge length in Angstroms, 0 for automatic.
+     */
+    void setCellSize (float size) { cellSize = size; }
+
+    /**
+     * Sets the number of threads computing the relations of the created
+     * models.
+     * @param nb the number of threads.
+     */
+    void setNbThreads (unsigned int nb) { nbThreads = nb; }
+
     // METHODS --------------------------------------------------------------
 
     /**
@@ -189,6 +272,21 @@ namespace annotate
    */
   class AnnotateModel : public GraphModel
   {
+  public:
+
+    /**
+     * The tag opening a snapshot stream.
+     */
+    static const unsigned int SNAPSHOT_MAGIC = 0x4d434153;
+
+    /**
+     * The snapshot format version, raised whenever the layout written by
+     * writeSnapshot changes.
+     */
+    static const unsigned int SNAPSHOT_VERSION = 1;
+
+  private:
+
     /**
      * The model name.
      */
@@ -205,28 +303,190 @@ namespace annotate
     int nb_pairings;
     int min_helix_size;
 
+    /**
+     * A run of unpaired residues of a loop, from its first to its last
+     * sequential id.
+     */
     struct OStrand : public pair< label, label > {
       stype type;
       int ref;
     };
 
+    /**
+     * A loop of the nested structure: the closing pair (none for the
+     * exterior loop of a strand), the pairs of the branches and the
+     * strands between them, in 5' to 3' order.  The pairs are vertex
+     * labels.
+     */
+    struct OLoop {
+      stype type;
+      bool closed;
+      vector< pair< label, label > > pairs;
+      vector< unsigned int > strands;
+    };
+
+    /**
+     * The compressed adjacency of the annotated graph, built by annotate.
+     */
+    AdjacencyTable adjacency;
+
+    /**
+     * The base pairs, stacks and links in key order, filled by
+     * fillSeqBPStacks.  The dumps read it instead of the vectors below,
+     * which are derived from it for the structure searches.
+     */
+    RelationTable relationTable;
+
     vector< BasePair > basepairs;
     vector< BaseStack > stacks;
     vector< BaseLink > links;
+
+    /**
+     * The label classes tested on every relation, taken by fillRecords
+     * once the labels of the model have their ids.  The helix mask holds
+     * the Saenger and one H-bond labels.
+     */
+    LabelSet pairingMask;
+    LabelSet helixMask;
+    LabelSet stackMask;
+    LabelSet adjacentMask;
     vector< Helix > helices;
-//     vector< OStrand > strands;
+
+    /**
+     * The base triples and larger multiplets, by first residue.
+     */
+    vector< Multiplet > multiplets;
+
+    /**
+     * The unpaired runs, in strand order.
+     */
+    vector< OStrand > strands;
+
+    /**
+     * The loops, by position of their first residue.
+     */
+    vector< OLoop > loops;
     
 //     vector< int > sequence_length;
     vector< unsigned int > marks;
 
-    map< label, int > helix_mask;
-    map< label, int > strand_mask;
-    map< label, int > sequence_mask;
-    map< label, int > tertiary_mask;
+    /**
+     * The residue on the 3' and on the 5' side of each residue along its
+     * chain, -1 at a chain end, from the links.
+     */
+    vector< int > next3p;
+    vector< int > next5p;
+
+    /**
+     * The helix of each residue, -1 outside the helices.
+     */
+    vector< int > helix_mask;
+
+    /**
+     * The pairs of crossing helices (i, j), i < j, in order.
+     */
+    vector< pair< unsigned int, unsigned int > > crossings;
+
+    /**
+     * The pseudoknot order of each helix, 0 for the helices left nested by
+     * the helices of lower order.
+     */
+    vector< unsigned int > helix_order;
+
+    /**
+     * The loop of each unpaired residue of a strand, -1 elsewhere.
+     */
+    vector< int > strand_mask;
+
+    /**
+     * The strand of each residue in sequences, -1 for the residues
+     * without links.
+     */
+    vector< int > sequence_mask;
+
+    /**
+     * The sequential id of each residue in sequences, -1 for the residues
+     * without links.
+     */
+    vector< int > sequence_rank;
+
+    /**
+     * The dot-bracket structure of the strands put end to end, indexed by
+     * sequential id: a bracket pair of one of the PAGES levels for each
+     * paged helix pairing, '.' elsewhere.
+     */
+    string dot_bracket;
+
+    /**
+     * The number of helix pairings beyond the PAGES levels.
+     */
+    unsigned int nbUnpaged;
+
+    /**
+     * 1 for the residues of a tertiary interaction, 0 elsewhere.
+     */
+    vector< int > tertiary_mask;
+
+    /**
+     * The relation table rows of the classified base pairs that are not
+     * helical, in order.
+     */
+    vector< unsigned int > tertiaryRows;
+
+    /**
+     * The kissing loop complexes: the pairs (row, complex) of the base
+     * pairs joining two hairpin loops, by complex then row.
+     */
+    vector< pair< unsigned int, unsigned int > > kissingRows;
+
+    /**
+     * The hairpin loops of each kissing loop complex.
+     */
+    vector< pair< unsigned int, unsigned int > > kissingLoops;
+
+    /**
+     * The numbers of base pairs, of helical base pairs and of classified
+     * base pairs.
+     */
+    unsigned int nbPairings;
+    unsigned int nbHelicalPairings;
+    unsigned int nbClassified;
 
     ResIdSet residueSelection;
 
     unsigned int environment;
+
+    /**
+     * The edge length of the spatial grid cells, 0 for automatic.
+     */
+    float cellSize;
+
+    /**
+     * The number of threads computing the relations.
+     */
+    unsigned int nbThreads;
+
+    /**
+     * The trajectory neighbor list providing the candidate pairs, null to
+     * use a spatial grid.  It is not owned by the model.
+     */
+    NeighborList *neighborList;
+
+    /**
+     * The number of residue pairs an all-pairs annotation would evaluate.
+     */
+    unsigned long nbPairs;
+
+    /**
+     * The number of residue pairs kept by the spatial grid.
+     */
+    unsigned long nbCandidates;
+
+    /**
+     * The residue bounding spheres in label order, filled once the residues
+     * are read.
+     */
+    SphereTable spheres;
         
   public:
     
@@ -242,8 +502,17 @@ namespace annotate
      */
     AnnotateModel (const ResIdSet &rs, unsigned int env, const ResidueFactoryMethod *fm = 0)
       : GraphModel (fm),
+	nbUnpaged (0),
+	nbPairings (0),
+	nbHelicalPairings (0),
+	nbClassified (0),
 	residueSelection (rs),
-	environment (env)
+	environment (env),
+	cellSize (0),
+	nbThreads (1),
+	neighborList (0),
+	nbPairs (0),
+	nbCandidates (0)
     { }
     
     /**
@@ -257,8 +526,17 @@ namespace annotate
      */
     AnnotateModel (const AbstractModel &right, const ResIdSet &rs, unsigned int env, const ResidueFactoryMethod *fm = 0)
       : GraphModel (right, fm),
+	nbUnpaged (0),
+	nbPairings (0),
+	nbHelicalPairings (0),
+	nbClassified (0),
 	residueSelection (rs),
-	environment (env)
+	environment (env),
+	cellSize (0),
+	nbThreads (1),
+	neighborList (0),
+	nbPairs (0),
+	nbCandidates (0)
     { }
 
     /**
@@ -269,17 +547,127 @@ namespace annotate
     // OPERATORS ------------------------------------------------------------
     
     // ACCESS ---------------------------------------------------------------
+
+    /**
+     * Sets the spatial grid cell size.
+     * @param size the cell edge length in Angstroms, 0 for automatic.
+     */
+    void setCellSize (float size) { cellSize = size; }
+
+    /**
+     * Sets the number of threads computing the relations.
+     * @param nb the number of threads.
+     */
+    void setNbThreads (unsigned int nb) { nbThreads = nb; }
+
+    /**
+     * Sets the trajectory neighbor list giving the candidate pairs of a
+     * full annotation, the previous frames' list is then reused when
+     * possible.
+     * @param nl the neighbor list, null to use a spatial grid.
+     */
+    void setNeighborList (NeighborList *nl) { neighborList = nl; }
+
+    /**
+     * Gets the number of residue pairs an all-pairs annotation would have
+     * evaluated during the last annotate.
+     */
+    unsigned long getNbPairs () const { return nbPairs; }
+
+    /**
+     * Gets the number of residue pairs pruned by the spatial grid during
+     * the last annotate.
+     */
+    unsigned long getNbPrunedPairs () const { return nbPairs - nbCandidates; }
+
+    /**
+     * Gets the atom distance under which two residues are in contact and
+     * their relation is computed.
+     */
+    static float getContactCutoff ();
+
+    /**
+     * Gets the adjacency snapshot of the annotated graph, for linear scans
+     * of the neighbors.  It is valid once annotate or readSnapshot returns;
+     * a restored model has the edges of its relation table rows, without
+     * relation objects.
+     */
+    const AdjacencyTable& getAdjacency () const { return adjacency; }
+
+    /**
+     * Gets the base pairs, in key order, once annotated.
+     */
+    const vector< BasePair >& getBasePairs () const { return basepairs; }
+
+    /**
+     * Gets the stacks, in key order, once annotated.
+     */
+    const vector< BaseStack >& getStacks () const { return stacks; }
+
+    /**
+     * Gets the relation between two residues of the annotated graph.
+     * @param from the first residue label.
+     * @param to the second residue label.
+     * @return the relation, null if the residues are not related or the
+     * model was restored by readSnapshot.
+     */
+    const Relation* getRelation (label from, label to) const
+    {
+      return adjacency.getRelation (from, to);
+    }
     
     // METHODS --------------------------------------------------------------
 
     /**
-     * Builds the graph of relations, find strands and helices.
+     * Builds the graph of relations, find strands and helices.  When a
+     * residue selection is given, only the relations involving the selected
+     * residues and their environment layers are computed.
      */
     void annotate ();
     
   private :
+
+    /**
+     * Fills the bounding sphere table from the residues' atoms, once
+     * they are finalized.
+     */
+    void computeSpheres ();
+
+    /**
+     * Computes the relations of every residue pair in contact.  The pairs
+     * are taken from a spatial grid over the residue bounding spheres.
+     */
+    void annotateAll ();
+
+    /**
+     * Computes the relations touching the residue selection, then grows
+     * the annotated region breadth-first by the given number of environment
+     * layers of relation neighbors.  The resulting graph holds exactly the
+     * relations of a full annotation having at least one end in the
+     * selection or in one of its environment layers.
+     */
+    void annotateSelection ();
+
+    /**
+     * Computes the relations of residue pairs in contact and adds them to
+     * the graph in both directions.  The pairs are evaluated by nbThreads
+     * threads, then added in pair order, so the graph does not depend on
+     * the thread count.
+     * @param pairs the residue label pairs.
+     * @param related if not null, tells for each pair if it is related
+     * (output).
+     */
+    void relatePairs (const vector< pair< unsigned int, unsigned int > > &pairs,
+		      vector< bool > *related = 0);
     
-    bool isHelixPairing (const Relation &r);
+    /**
+     * Tells if a base pair can be part of a helix.
+     * @param labels the labels of the base pair.
+     */
+    bool isHelixPairing (const LabelSet &labels) const
+    {
+      return labels.intersects (pairingMask) && labels.intersects (helixMask);
+    }
 
     bool isPairing (const Relation *r)
     {
@@ -294,37 +682,250 @@ namespace annotate
   public:
  
 
+    /**
+     * Freezes the relations of the graph into the adjacency table.
+     */
+    void freezeGraph ();
+
     void fillSeqBPStacks ();
+
+    /**
+     * Derives the base pair, stack and link records, the pairing marks and
+     * the label class masks from the sorted relation table.
+     */
+    void fillRecords ();
+
+    /**
+     * Finds the secondary structure elements from the records.
+     */
+    void findStructures ();
+
+    /**
+     * Fills next3p and next5p from the links.  The links between two
+     * chains are left out.
+     */
+    void linkResidues ();
+
+    /**
+     * Builds the strands of linked residues in sequences, in 5' to 3'
+     * order, and fills sequence_mask.  Each residue is visited once.
+     */
+    void buildStrands ();
+
+    /**
+     * Finds the helices: the runs of at least MIN_HELIX_SIZE stacked helix
+     * pairings (i, j), (i + 1, j - 1)... where the neighbors on each strand
+     * are linked.  Each pairing is looked up once in a hashed pair index,
+     * so the time is linear in the number of base pairs.
+     */
     void findHelices ();
 
 
 
-    void buildStrands();
-    
     void findHelices (const set< pair< label, label > > &helixPairsCandidates);
-    void dumpHelices () const;
+    void dumpHelices (TextWriter &tw, const vector< string > &resIds) const;
     
-    void findStrands ();
-    void classifyStrands ();
-    void dumpStrands ();
+    /**
+     * Decomposes the first dot-bracket level into loops in one pass over
+     * each strand, a stack holding the loops open at the current residue.
+     * A loop is classified when its closing pair ends: hairpin loop (LOOP)
+     * without branch, bulge or internal loop with one branch (stacked
+     * pairs are not kept), n-way junction (JUNCTION) with more.  The
+     * exterior loop of a strand is OTHER.
+     */
+    void findLoops ();
+
+    /**
+     * Writes the loops, their pairs and their strands.
+     * @param tw the writer.
+     * @param resIds the residue id texts.
+     */
+    void dumpLoops (TextWriter &tw, const vector< string > &resIds) const;
+
+    /**
+     * Writes a run of residues as first-sequence-last.
+     * @param tw the writer.
+     * @param resIds the residue id texts.
+     * @param first the sequential id of the first residue.
+     * @param last the sequential id of the last residue.
+     */
+    void dumpRun (TextWriter &tw, const vector< string > &resIds,
+		  unsigned int first, unsigned int last) const;
+    /**
+     * Classifies every base pair in one pass over the relation table from
+     * the helix, loop and loop type of its residues: helical, inter helix,
+     * intraloop or region/region (loop/helix, bulge/loop...).  Fills
+     * tertiary_mask and groups the pairs joining two hairpin loops in
+     * kissing loop complexes.
+     */
     void findKissingHairpins ();
+
+    /**
+     * Gets the name of the region of a residue in the tertiary classes.
+     * @param l the vertex label.
+     * @return "helix", the loop type name, or null outside the helices and
+     * the loops.
+     */
+    const char* getRegionName (label l) const;
+
+    /**
+     * Writes the class of each tertiary interaction, the kissing loop
+     * complexes and the pair counts, with a warning when some pairs are
+     * not classified.
+     * @param tw the writer.
+     * @param resIds the residue id texts.
+     * @param order the label order.
+     */
+    void dumpTertiaries (TextWriter &tw, const vector< string > &resIds,
+			 const LabelOrder &order) const;
+
+    /**
+     * Finds the crossing helices, the pairs of helices within a strand whose
+     * spans [a, d] and [a', d'] in strand order verify a < a' < d < d'.  The
+     * helices are swept by start, each span end entering a RankTree, so the
+     * helices crossing one are listed from a rank range in O(log n) time
+     * each.  The pseudoknot orders are then given greedily, longest helix
+     * first, the lowest order not taken by a crossing helix.
+     */
     void findPseudoknots ();
 
-    void dumpSequences (bool detailed = true) ;
-    void dumpPairs () const;
-    void dumpConformations () const;
-    void dumpTriples () ;
-    void dumpStacks () const;
+    /**
+     * Finds the multiplets: the connected sets of at least three residues
+     * joined by base pairs.  The residues are merged in a union-find over
+     * one pass on the sorted base pairs, so the time is linear.
+     */
+    void findMultiplets ();
+
+    /**
+     * Gets the representative of a residue set in a union-find forest.
+     * @param root the parent of each vertex label, compressed on the way.
+     * @param l the vertex label.
+     * @return the representative label.
+     */
+    static unsigned int findRoot (vector< unsigned int > &root, unsigned int l);
+
+    /**
+     * Fills dot_bracket from the helix pairings (see isHelixPairing) within
+     * a strand.  The first level holds a largest nested subset of them
+     * (see NestedPairs), each next level a largest nested subset of the
+     * pairings left whose residues are still unpaired.
+     */
+    void buildDotBracket ();
+
+    /**
+     * Writes the sequence and the dot-bracket structure of every strand.
+     * @param tw the writer.
+     * @param resIds the residue id texts.
+     */
+    void dumpDotBracket (TextWriter &tw, const vector< string > &resIds) const;
+
+    /**
+     * Writes the crossing helices and the pseudoknot orders.
+     * @param tw the writer.
+     */
+    void dumpPseudoknots (TextWriter &tw) const;
+
+    /**
+     * Writes the strands with, under each residue, its helix marks and the
+     * last digit of its helix number (detailed), or only their sequence.
+     * @param tw the writer.
+     * @param resIds the residue id texts.
+     * @param detailed whether to write the marks.
+     */
+    void dumpSequences (TextWriter &tw, const vector< string > &resIds,
+			bool detailed = true) const;
+
+    /**
+     * Formats the residue ids once for the dumps.
+     * @param resIds the residue id texts indexed by vertex label (output).
+     */
+    void formatResIds (vector< string > &resIds) const;
+
+    /**
+     * Writes the labels of a relation in text report order, each followed
+     * by a space.
+     * @param tw the writer.
+     * @param labels the labels.
+     * @param order the label order.
+     */
+    static void dumpLabels (TextWriter &tw, const LabelSet &labels, const LabelOrder &order);
+
+    /**
+     * Writes the labels of a relation as a JSON "labels" member.
+     * @param tw the writer.
+     * @param labels the labels.
+     * @param order the label order.
+     */
+    static void dumpJsonLabels (TextWriter &tw, const LabelSet &labels, const LabelOrder &order);
+
+    /**
+     * Writes the JSON record of a relation: its residues and their types,
+     * the paired faces of a base pair, the adjacency of a stack and the
+     * labels.
+     * @param tw the writer.
+     * @param head the opening of the record, with the file and model.
+     * @param type the record type.
+     * @param row the relation table row.
+     * @param resIds the residue id texts.
+     * @param order the label order.
+     */
+    void dumpJsonRelation (TextWriter &tw, const string &head, const char *type,
+			   unsigned int row, const vector< string > &resIds,
+			   const LabelOrder &order) const;
+
+    /**
+     * Writes a base pair line: its residues, their types, the paired faces
+     * and the labels.
+     * @param tw the writer.
+     * @param row the relation table row.
+     * @param resIds the residue id texts.
+     * @param order the label order.
+     */
+    void dumpPair (TextWriter &tw, unsigned int row, const vector< string > &resIds,
+		   const LabelOrder &order) const;
+
+    void dumpPairs (TextWriter &tw, const vector< string > &resIds, const LabelOrder &order) const;
+    void dumpConformations (TextWriter &tw, const vector< string > &resIds) const;
+
+    /**
+     * Writes every multiplet, its residues then its base pairs.
+     * @param tw the writer.
+     * @param resIds the residue id texts.
+     * @param order the label order.
+     */
+    void dumpMultiplets (TextWriter &tw, const vector< string > &resIds,
+			 const LabelOrder &order) const;
+    void dumpStacks (TextWriter &tw, const vector< string > &resIds, const LabelOrder &order) const;
 
     // I/O  -----------------------------------------------------------------
   
     /**
-     * Ouputs the model to the stream.
+     * Ouputs the model to the stream.  Nothing is written to the global
+     * message streams, so models may be output concurrently to distinct
+     * streams.
      * @param os the output stream.
      * @return the used output stream.
      */
     virtual ostream& output (ostream &os) const;
 
+    /**
+     * Outputs the model as JSON Lines: one record per residue conformation,
+     * stack, link, base pair, multiplet, pair of crossing helices and
+     * strand structure, in this order.
+     * @param os the output stream.
+     * @param file the input file name, copied to every record.
+     * @param model the model number in the file, copied to every record.
+     * @return the used output stream.
+     */
+    ostream& outputJsonl (ostream &os, const string &file, unsigned int model) const;
+
+    /**
+     * Adds the model to a binary annotation block.
+     * @param bw the block writer.
+     * @param model the model number in the file.
+     */
+    void outputBinary (BinaryWriter &bw, unsigned int model) const;
+
     /**
      * Reads the model from a pdb input stream.
      * @param is the pdb data stream.
@@ -332,13 +933,6 @@ namespace annotate
      */
     virtual iPdbstream& input (iPdbstream &is);
   
-//     /**
-//      * Writes the model to a binary output stream.
-//      * @param obs the binary data stream.
-//      * @return the consumed binary stream.
-//      */
-//     virtual oBinstream& output (oBinstream &obs) const;
-
     /**
      * Reads the model from a binary input stream.
      * @param is the binary data stream.
@@ -346,23 +940,41 @@ namespace annotate
      */
     virtual iBinstream& input (iBinstream &iss);
 
-  };
+    /**
+     * Writes the annotated model as a snapshot: its residues, then its
+     * relation table rows in key order with their labels and paired faces.
+     * The labels and faces are written by name, so a snapshot does not
+     * depend on the label ids of the writing process.
+     * @param obs the binary data stream.
+     * @return the consumed binary stream.
+     */
+    oBinstream& writeSnapshot (oBinstream &obs) const;
+
+    /**
+     * Reads a model written by writeSnapshot.  The relations are not
+     * recomputed: the relation table and the records are restored as they
+     * were, without relation objects, and the model goes straight to the
+     * output methods.
+     * @param is the binary data stream.
+     * @return the consumed binary stream.
+     * @exception FatalIntLibException when the snapshot is corrupted.
+     */
+    iBinstream& readSnapshot (iBinstream &is);
 
-//   /**
-//    * Reads the AnnotateModel from a binary input stream.
-//    * @param is the binary input stream.
-//    * @param model the AnnotateModel.
-//    * @return the consumed binary stream.
-//    */
-//   iBinstream& operator>> (iBinstream &is, AnnotateModel &model);
-
-//   /**
-//    * Writes the AnnotateModel to a binary output stream.
-//    * @param os the binary input stream.
-//    * @param model the AnnotateModel.
-//    * @return the consumed binary stream.
-//    */
-//   oBinstream& operator<< (oBinstream &os, const AnnotateModel &model);
+    /**
+     * Writes the tag and version opening a snapshot stream.
+     * @param obs the binary data stream.
+     */
+    static void writeSnapshotHeader (oBinstream &obs);
+
+    /**
+     * Reads the tag and version opening a snapshot stream.
+     * @param is the binary data stream.
+     * @return the snapshot version, 0 if the stream is not a snapshot.
+     */
+    static unsigned int readSnapshotHeader (iBinstream &is);
+
+  };
 
 }
 
@@ -18,6 +18,8 @@
 #include "mccore/GraphModel.h"
 #include "mccore/ResId.h"
 
+#include "LabelTable.h"
+
 using namespace mccore;
 using namespace std;
 
@@ -34,13 +36,20 @@ namespace annotate
     ResId fResId;
 
     ResId rResId;
+
+    /**
+     * The labels of the relation.
+     */
+    LabelSet labels;
     
     // LIFECYCLE ------------------------------------------------------------
 
-    BasePair (GraphModel::label l, const ResId &fResId, GraphModel::label r, const ResId &rResId)
+    BasePair (GraphModel::label l, const ResId &fResId, GraphModel::label r, const ResId &rResId,
+	      const LabelSet &labels = LabelSet ())
       : pair< GraphModel::label, GraphModel::label > (l, r),
 	fResId (fResId),
-	rResId (rResId)
+	rResId (rResId),
+	labels (labels)
     { }
 
     ~BasePair () { }
@@ -60,6 +69,7 @@ namespace annotate
 	  second = right.second;
 	  fResId = right.fResId;
 	  rResId = right.rResId;
+	  labels = right.labels;
 	}
       return *this;
     }
@@ -17,6 +17,8 @@
 #include "mccore/GraphModel.h"
 #include "mccore/ResId.h"
 
+#include "LabelTable.h"
+
 using namespace mccore;
 using namespace std;
 
@@ -34,12 +36,19 @@ namespace annotate
 
     ResId rResId;
 
+    /**
+     * The labels of the relation.
+     */
+    LabelSet labels;
+
     // LIFECYCLE ------------------------------------------------------------
 
-    BaseStack (GraphModel::label l, const ResId &fResId, GraphModel::label r, const ResId &rResId)
+    BaseStack (GraphModel::label l, const ResId &fResId, GraphModel::label r, const ResId &rResId,
+	       const LabelSet &labels = LabelSet ())
       : pair< GraphModel::label, GraphModel::label > (l, r),
 	fResId (fResId),
-	rResId (rResId)
+	rResId (rResId),
+	labels (labels)
     { }
 
     ~BaseStack () { }
@@ -59,6 +68,7 @@ namespace annotate
 	  second = right.second;
 	  fResId = right.fResId;
 	  rResId = right.rResId;
+	  labels = right.labels;
 	}
       return *this;
     }
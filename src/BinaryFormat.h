@@ -0,0 +1,131 @@
+//                              -*- Mode: C++ -*-
+// BinaryFormat.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Wed Apr  6 10:18:52 2011
+
+
+#ifndef _annotate_BinaryFormat_h_
+#define _annotate_BinaryFormat_h_
+
+#include <stdint.h>
+
+
+
+/**
+ * Layout of the binary annotation files (--format binary).
+ *
+ * Every annotated input file produces one self-contained block, and the
+ * blocks of several input files are simply concatenated.  A block is:
+ *
+ *   BinaryHeader
+ *   for each model: BinaryResidue[nbResidues]
+ *                   BinaryRelation[nbStacks + nbLinks + nbPairs]
+ *                   BinaryFace[nbFaces]
+ *   footer:         BinaryModel[nbModels]
+ *                   BinaryLabel[nbLabels]
+ *                   uint32_t[nbNames]     (name offsets in the pool)
+ *                   char[poolSize]        (NUL terminated names, padded to 8)
+ *   BinaryTrailer
+ *
+ * Offsets are relative to the start of the block, and all the records are
+ * 8 byte aligned, so that a mapped file is read in place.  The integers are
+ * in the byte order of the writing host.  A block is located from the end
+ * of the file: its trailer gives its size, and the previous block ends
+ * where it starts.
+ *
+ * The residue ids, residue types, puckers, glycosyls and faces are indexes
+ * in the per-block name dictionary.  The relation labels are bits of a
+ * mask, bit i standing for the label i of the block.  The rank of a label
+ * is its position in the order the text report lists the labels in.
+ */
+namespace annotate
+{
+
+  static const char BINARY_MAGIC[4] = { 'M', 'C', 'A', 'B' };
+  static const char BINARY_TRAILER_MAGIC[4] = { 'M', 'C', 'A', 'E' };
+  static const uint32_t BINARY_VERSION = 1;
+
+  /**
+   * The name index of an absent property.
+   */
+  static const uint32_t BINARY_NONE = 0xffffffff;
+
+  /**
+   * The maximum number of distinct relation labels of a block.
+   */
+  static const unsigned int BINARY_MAX_LABELS = 128;
+
+  /**
+   * The relation kinds, also their storage order in a model.
+   */
+  enum BinaryRelationKind { BINARY_STACK = 0, BINARY_LINK = 1, BINARY_PAIR = 2 };
+
+  /**
+   * The relation flags.
+   */
+  enum { BINARY_ADJACENT = 1 };
+
+  struct BinaryHeader
+  {
+    char magic[4];
+    uint32_t version;
+  };
+
+  struct BinaryResidue
+  {
+    uint32_t resId;
+    uint32_t type;
+    uint32_t pucker;
+    uint32_t glycosyl;
+  };
+
+  struct BinaryRelation
+  {
+    uint32_t ref;
+    uint32_t res;
+    uint32_t faceStart;
+    uint16_t nbFaces;
+    uint8_t kind;
+    uint8_t flags;
+    uint64_t labels[BINARY_MAX_LABELS / 64];
+  };
+
+  struct BinaryFace
+  {
+    uint32_t first;
+    uint32_t second;
+  };
+
+  struct BinaryModel
+  {
+    uint64_t offset;
+    uint32_t model;
+    uint32_t nbResidues;
+    uint32_t nbStacks;
+    uint32_t nbLinks;
+    uint32_t nbPairs;
+    uint32_t nbFaces;
+  };
+
+  struct BinaryLabel
+  {
+    uint32_t name;
+    uint32_t rank;
+  };
+
+  struct BinaryTrailer
+  {
+    uint64_t footer;
+    uint64_t size;
+    uint32_t nbModels;
+    uint32_t nbLabels;
+    uint32_t nbNames;
+    uint32_t poolSize;
+    char magic[4];
+    uint32_t version;
+  };
+
+}
+
+#endif
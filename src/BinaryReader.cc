@@ -0,0 +1,321 @@
+//                              -*- Mode: C++ -*-
+// BinaryReader.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Wed Apr  6 14:02:37 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BinaryReader.h"
+
+
+
+namespace annotate
+{
+
+  BinaryReader::BinaryReader ()
+    : mapping (0),
+      length (0)
+  { }
+
+
+  BinaryReader::~BinaryReader ()
+  {
+    close ();
+  }
+
+
+  bool
+  BinaryReader::open (const string &filename)
+  {
+    int fd;
+    struct stat st;
+    void *addr;
+    unsigned long end;
+
+    close ();
+    if (0 > (fd = ::open (filename.c_str (), O_RDONLY)))
+      {
+	return false;
+      }
+    if (0 != fstat (fd, &st) || 0 == st.st_size)
+      {
+	::close (fd);
+	return false;
+      }
+    addr = mmap (0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close (fd);
+    if (MAP_FAILED == addr)
+      {
+	return false;
+      }
+    mapping = (const char*) addr;
+    length = st.st_size;
+
+    for (end = length; 0 != end; end -= blocks.back ().trailer->size)
+      {
+	blocks.push_back (Block ());
+	if (! locate (end, blocks.back ()))
+	  {
+	    close ();
+	    return false;
+	  }
+      }
+    reverse (blocks.begin (), blocks.end ());
+    return true;
+  }
+
+
+  void
+  BinaryReader::close ()
+  {
+    if (0 != mapping)
+      {
+	munmap ((void*) mapping, length);
+	mapping = 0;
+	length = 0;
+      }
+    blocks.clear ();
+  }
+
+
+  bool
+  BinaryReader::locate (unsigned long end, Block &b) const
+  {
+    const BinaryHeader *header;
+    vector< pair< uint32_t, unsigned int > > ranks;
+    unsigned int i;
+    uint64_t footerSize;
+
+    if (sizeof (BinaryHeader) + sizeof (BinaryTrailer) > end
+	|| 0 != end % 8)
+      {
+	return false;
+      }
+    b.trailer = (const BinaryTrailer*) (mapping + end - sizeof (BinaryTrailer));
+    if (0 != memcmp (b.trailer->magic, BINARY_TRAILER_MAGIC, sizeof (b.trailer->magic))
+	|| BINARY_VERSION != b.trailer->version
+	|| end < b.trailer->size
+	|| sizeof (BinaryHeader) + sizeof (BinaryTrailer) > b.trailer->size
+	|| 0 != b.trailer->size % 8
+	|| BINARY_MAX_LABELS < b.trailer->nbLabels)
+      {
+	return false;
+      }
+    b.base = mapping + end - b.trailer->size;
+    header = (const BinaryHeader*) b.base;
+    if (0 != memcmp (header->magic, BINARY_MAGIC, sizeof (header->magic))
+	|| BINARY_VERSION != header->version)
+      {
+	return false;
+      }
+    footerSize = (b.trailer->nbModels * sizeof (BinaryModel)
+		  + b.trailer->nbLabels * sizeof (BinaryLabel)
+		  + b.trailer->nbNames * sizeof (uint32_t)
+		  + b.trailer->poolSize);
+    if (b.trailer->footer < sizeof (BinaryHeader)
+	|| 0 != b.trailer->footer % 8
+	|| b.trailer->footer + footerSize + sizeof (BinaryTrailer) > b.trailer->size)
+      {
+	return false;
+      }
+    b.models = (const BinaryModel*) (b.base + b.trailer->footer);
+    b.labels = (const BinaryLabel*) (b.models + b.trailer->nbModels);
+    b.nameOffsets = (const uint32_t*) (b.labels + b.trailer->nbLabels);
+    b.pool = (const char*) (b.nameOffsets + b.trailer->nbNames);
+
+    // The names must end in the pool.
+    if (0 != b.trailer->nbNames
+	&& (0 == b.trailer->poolSize || '\0' != b.pool[b.trailer->poolSize - 1]))
+      {
+	return false;
+      }
+    for (i = 0; i < b.trailer->nbNames; ++i)
+      {
+	if (b.nameOffsets[i] >= b.trailer->poolSize)
+	  {
+	    return false;
+	  }
+      }
+    for (i = 0; i < b.trailer->nbModels; ++i)
+      {
+	if (! checkModel (b, b.models[i]))
+	  {
+	    return false;
+	  }
+      }
+    for (i = 0; i < b.trailer->nbLabels; ++i)
+      {
+	if (b.labels[i].name >= b.trailer->nbNames)
+	  {
+	    return false;
+	  }
+	ranks.push_back (make_pair (b.labels[i].rank, i));
+      }
+    sort (ranks.begin (), ranks.end ());
+    for (i = 0; i < ranks.size (); ++i)
+      {
+	b.labelOrder.push_back (ranks[i].second);
+      }
+    return true;
+  }
+
+
+  bool
+  BinaryReader::checkModel (const Block &b, const BinaryModel &m) const
+  {
+    uint32_t nbNames = b.trailer->nbNames;
+    uint64_t nbRelations = (uint64_t) m.nbStacks + m.nbLinks + m.nbPairs;
+    const BinaryResidue *residues;
+    const BinaryRelation *relations;
+    const BinaryFace *faces;
+    uint64_t i;
+
+    if (m.offset < sizeof (BinaryHeader)
+	|| 0 != m.offset % 8
+	|| m.offset > b.trailer->footer
+	|| (b.trailer->footer - m.offset
+	    < (uint64_t) m.nbResidues * sizeof (BinaryResidue)
+	    + nbRelations * sizeof (BinaryRelation)
+	    + (uint64_t) m.nbFaces * sizeof (BinaryFace)))
+      {
+	return false;
+      }
+    residues = (const BinaryResidue*) (b.base + m.offset);
+    relations = (const BinaryRelation*) (residues + m.nbResidues);
+    faces = (const BinaryFace*) (relations + nbRelations);
+
+    for (i = 0; i < m.nbResidues; ++i)
+      {
+	const BinaryResidue &r = residues[i];
+
+	if (r.resId >= nbNames
+	    || r.type >= nbNames
+	    || (BINARY_NONE != r.pucker
+		&& (r.pucker >= nbNames || r.glycosyl >= nbNames)))
+	  {
+	    return false;
+	  }
+      }
+    for (i = 0; i < nbRelations; ++i)
+      {
+	const BinaryRelation &r = relations[i];
+
+	if (r.ref >= m.nbResidues
+	    || r.res >= m.nbResidues
+	    || (uint64_t) r.faceStart + r.nbFaces > m.nbFaces)
+	  {
+	    return false;
+	  }
+      }
+    for (i = 0; i < m.nbFaces; ++i)
+      {
+	if (faces[i].first >= nbNames || faces[i].second >= nbNames)
+	  {
+	    return false;
+	  }
+      }
+    return true;
+  }
+
+
+  void
+  BinaryReader::outputLabels (ostream &os, unsigned int block, const BinaryRelation &r) const
+  {
+    const vector< unsigned int > &order = blocks[block].labelOrder;
+    vector< unsigned int >::const_iterator it;
+
+    for (it = order.begin (); order.end () != it; ++it)
+      {
+	if (0 != (r.labels[*it / 64] & ((uint64_t) 1 << (*it % 64))))
+	  {
+	    os << getLabelName (block, *it) << ' ';
+	  }
+      }
+  }
+
+
+  ostream&
+  BinaryReader::outputText (ostream &os, unsigned int block, unsigned int model) const
+  {
+    const BinaryModel &m = getModel (block, model);
+    const BinaryResidue *residues = getResidues (block, model);
+    const BinaryRelation *stacks = getRelations (block, model);
+    const BinaryRelation *pairs = stacks + m.nbStacks + m.nbLinks;
+    const BinaryFace *faces = getFaces (block, model);
+    unsigned int nbAdjacent;
+    unsigned int i;
+    unsigned int j;
+
+    os << "Residue conformations -------------------------------------------" << '\n';
+    for (i = 0; i < m.nbResidues; ++i)
+      {
+	const BinaryResidue &r = residues[i];
+
+	os << getName (block, r.resId) << " : " << getName (block, r.type);
+	if (BINARY_NONE != r.pucker)
+	  {
+	    os << ' ' << getName (block, r.pucker)
+	       << ' ' << getName (block, r.glycosyl);
+	  }
+	os << '\n';
+      }
+
+    os << "Adjacent stackings ----------------------------------------------" << '\n';
+    for (nbAdjacent = 0, i = 0; i < m.nbStacks; ++i)
+      {
+	if (0 != (stacks[i].flags & BINARY_ADJACENT))
+	  {
+	    os << getName (block, residues[stacks[i].ref].resId) << '-'
+	       << getName (block, residues[stacks[i].res].resId) << " : ";
+	    outputLabels (os, block, stacks[i]);
+	    os << '\n';
+	    ++nbAdjacent;
+	  }
+      }
+    os << "Non-Adjacent stackings ------------------------------------------" << '\n';
+    for (i = 0; i < m.nbStacks; ++i)
+      {
+	if (0 == (stacks[i].flags & BINARY_ADJACENT))
+	  {
+	    os << getName (block, residues[stacks[i].ref].resId) << '-'
+	       << getName (block, residues[stacks[i].res].resId) << " : ";
+	    outputLabels (os, block, stacks[i]);
+	    os << '\n';
+	  }
+      }
+    os << "Number of stackings = " << m.nbStacks << '\n'
+       << "Number of adjacent stackings = " << nbAdjacent << '\n'
+       << "Number of non adjacent stackings = " << m.nbStacks - nbAdjacent << '\n';
+
+    os << "Base-pairs ------------------------------------------------------" << '\n';
+    for (i = 0; i < m.nbPairs; ++i)
+      {
+	const BinaryRelation &r = pairs[i];
+
+	os << getName (block, residues[r.ref].resId) << '-'
+	   << getName (block, residues[r.res].resId) << " : "
+	   << getName (block, residues[r.ref].type) << '-'
+	   << getName (block, residues[r.res].type) << ' ';
+	for (j = r.faceStart; j < r.faceStart + r.nbFaces; ++j)
+	  {
+	    os << getName (block, faces[j].first) << '/'
+	       << getName (block, faces[j].second) << ' ';
+	  }
+	outputLabels (os, block, r);
+	os << '\n';
+      }
+    return os;
+  }
+
+}
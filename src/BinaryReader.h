@@ -0,0 +1,209 @@
+//                              -*- Mode: C++ -*-
+// BinaryReader.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Wed Apr  6 14:02:37 2011
+
+
+#ifndef _annotate_BinaryReader_h_
+#define _annotate_BinaryReader_h_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "BinaryFormat.h"
+
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Maps a binary annotation file in memory for reading in place.
+   *
+   * The file is made of one block per annotated input file (see
+   * BinaryFormat.h).  The records are accessed through pointers into the
+   * mapping, without any parsing, and stay valid until the reader is closed.
+   * This class does not depend on mccore, so statistics programs only need
+   * the BinaryFormat.h and BinaryReader.h headers and the mcannotate-reader
+   * library.
+   */
+  class BinaryReader
+  {
+    /**
+     * The location of the parts of a block in the mapping.
+     */
+    struct Block
+    {
+      const char *base;
+      const BinaryTrailer *trailer;
+      const BinaryModel *models;
+      const BinaryLabel *labels;
+      const uint32_t *nameOffsets;
+      const char *pool;
+
+      /**
+       * The label bits in the order of the text report.
+       */
+      vector< unsigned int > labelOrder;
+    };
+
+    /**
+     * The file mapping.
+     */
+    const char *mapping;
+
+    /**
+     * The length of the mapping.
+     */
+    unsigned long length;
+
+    /**
+     * The blocks, in file order.
+     */
+    vector< Block > blocks;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    /**
+     * Initializes the object.
+     */
+    BinaryReader ();
+
+    /**
+     * Unmaps the file and destroys the object.
+     */
+    ~BinaryReader ();
+
+  private:
+
+    BinaryReader (const BinaryReader &right);
+
+    BinaryReader& operator= (const BinaryReader &right);
+
+  public:
+
+    // ACCESS ---------------------------------------------------------------
+
+    unsigned int getNbBlocks () const { return blocks.size (); }
+
+    unsigned int getNbModels (unsigned int block) const
+    {
+      return blocks[block].trailer->nbModels;
+    }
+
+    /**
+     * Gets the index entry of a model.
+     */
+    const BinaryModel& getModel (unsigned int block, unsigned int model) const
+    {
+      return blocks[block].models[model];
+    }
+
+    /**
+     * Gets the residues of a model, indexed by the relation residue indexes.
+     */
+    const BinaryResidue* getResidues (unsigned int block, unsigned int model) const
+    {
+      return (const BinaryResidue*) (blocks[block].base + getModel (block, model).offset);
+    }
+
+    /**
+     * Gets the relations of a model: its stacks, then its links, then its
+     * base pairs.
+     */
+    const BinaryRelation* getRelations (unsigned int block, unsigned int model) const
+    {
+      return (const BinaryRelation*) (getResidues (block, model)
+				      + getModel (block, model).nbResidues);
+    }
+
+    /**
+     * Gets the faces of a model, indexed by the faceStart of its relations.
+     */
+    const BinaryFace* getFaces (unsigned int block, unsigned int model) const
+    {
+      const BinaryModel &m = getModel (block, model);
+
+      return (const BinaryFace*) (getRelations (block, model)
+				  + m.nbStacks + m.nbLinks + m.nbPairs);
+    }
+
+    /**
+     * Gets a name of the block dictionary.
+     */
+    const char* getName (unsigned int block, uint32_t index) const
+    {
+      return blocks[block].pool + blocks[block].nameOffsets[index];
+    }
+
+    /**
+     * Gets the name of a label bit of the block.
+     */
+    const char* getLabelName (unsigned int block, unsigned int bit) const
+    {
+      return getName (block, blocks[block].labels[bit].name);
+    }
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Maps a binary annotation file and locates its blocks.
+     * @param filename the file name.
+     * @return false if the file cannot be mapped or is not a valid binary
+     * annotation file.
+     */
+    bool open (const string &filename);
+
+    /**
+     * Unmaps the file.
+     */
+    void close ();
+
+    // I/O  -----------------------------------------------------------------
+
+    /**
+     * Writes a model as the text report of mcannotate.
+     * @param os the output stream.
+     * @param block the block index.
+     * @param model the model index in the block.
+     * @return the used output stream.
+     */
+    ostream& outputText (ostream &os, unsigned int block, unsigned int model) const;
+
+  private:
+
+    /**
+     * Writes the labels of a relation in text report order, each followed
+     * by a space.
+     */
+    void outputLabels (ostream &os, unsigned int block, const BinaryRelation &r) const;
+
+    /**
+     * Locates the parts of the block ending at the given position.
+     * @param end the end of the block in the mapping.
+     * @param b the block (output).
+     * @return false if there is no valid block there.
+     */
+    bool locate (unsigned long end, Block &b) const;
+
+    /**
+     * Checks that the records of a model lie before the footer of its
+     * block, and that their residue, face and name indexes are in range,
+     * so that outputText may follow them.
+     * @param b the located block.
+     * @param m the model.
+     * @return false if the model is corrupted.
+     */
+    bool checkModel (const Block &b, const BinaryModel &m) const;
+
+  };
+
+}
+
+#endif
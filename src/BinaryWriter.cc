@@ -0,0 +1,256 @@
+//                              -*- Mode: C++ -*-
+// BinaryWriter.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Wed Apr  6 10:18:52 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "mccore/Exception.h"
+#include "mccore/stlio.h"
+
+#include "BinaryWriter.h"
+
+
+
+namespace annotate
+{
+
+  BinaryWriter::BinaryWriter (ostream &os)
+    : os (os),
+      written (0),
+      closed (false)
+  {
+    BinaryHeader header;
+
+    memset (&current, 0, sizeof (current));
+    memcpy (header.magic, BINARY_MAGIC, sizeof (header.magic));
+    header.version = BINARY_VERSION;
+    writeBytes (&header, sizeof (header));
+  }
+
+
+  BinaryWriter::~BinaryWriter ()
+  {
+    close ();
+  }
+
+
+  void
+  BinaryWriter::beginModel (unsigned int model)
+  {
+    residues.clear ();
+    relations.clear ();
+    faces.clear ();
+    memset (&current, 0, sizeof (current));
+    current.model = model;
+    adjacentMask = LabelTable::getMask (PropertyType::pAdjacent);
+  }
+
+
+  void
+  BinaryWriter::addResidue (const string &resId, const string &type, bool nucleic,
+			    const PropertyType *pucker, const PropertyType *glycosyl)
+  {
+    BinaryResidue r;
+
+    r.resId = getName (resId);
+    r.type = getName (type);
+    r.pucker = nucleic ? getName (pucker) : BINARY_NONE;
+    r.glycosyl = nucleic ? getName (glycosyl) : BINARY_NONE;
+    residues.push_back (r);
+  }
+
+
+  void
+  BinaryWriter::addRelation (BinaryRelationKind kind, const RelationTable &table, unsigned int row,
+			     const LabelOrder &order)
+  {
+    const LabelSet &ls = table.getLabels (row);
+    LabelOrder::const_iterator lit;
+    BinaryRelation r;
+
+    memset (&r, 0, sizeof (r));
+    r.ref = table.getRef (row);
+    r.res = table.getRes (row);
+    r.kind = kind;
+    r.flags = ls.intersects (adjacentMask) ? BINARY_ADJACENT : 0;
+    r.faceStart = faces.size ();
+    if (BINARY_PAIR == kind)
+      {
+	const RelationTable::Face *fit;
+
+	for (fit = table.getFacesBegin (row); table.getFacesEnd (row) != fit; ++fit)
+	  {
+	    BinaryFace f;
+
+	    f.first = getName (fit->first);
+	    f.second = getName (fit->second);
+	    faces.push_back (f);
+	  }
+	r.nbFaces = faces.size () - r.faceStart;
+      }
+    for (lit = order.begin (); order.end () != lit; ++lit)
+      {
+	map< const PropertyType*, uint32_t >::iterator it;
+
+	if (! ls.test (lit->second))
+	  {
+	    continue;
+	  }
+	if (labelIndex.end () == (it = labelIndex.find (lit->first)))
+	  {
+	    if (BINARY_MAX_LABELS == labels.size ())
+	      {
+		FatalIntLibException ex ("", __FILE__, __LINE__);
+
+		ex << "more than " << BINARY_MAX_LABELS << " relation labels in a binary block.";
+		throw ex;
+	      }
+	    it = labelIndex.insert (make_pair (lit->first, (uint32_t) labels.size ())).first;
+	    labels.push_back (lit->first);
+	  }
+	r.labels[it->second / 64] |= (uint64_t) 1 << (it->second % 64);
+      }
+    relations.push_back (r);
+    switch (kind)
+      {
+      case BINARY_STACK: ++current.nbStacks; break;
+      case BINARY_LINK: ++current.nbLinks; break;
+      case BINARY_PAIR: ++current.nbPairs; break;
+      }
+  }
+
+
+  void
+  BinaryWriter::endModel ()
+  {
+    current.offset = written;
+    current.nbResidues = residues.size ();
+    current.nbFaces = faces.size ();
+    if (! residues.empty ())
+      {
+	writeBytes (&residues[0], residues.size () * sizeof (BinaryResidue));
+      }
+    if (! relations.empty ())
+      {
+	writeBytes (&relations[0], relations.size () * sizeof (BinaryRelation));
+      }
+    if (! faces.empty ())
+      {
+	writeBytes (&faces[0], faces.size () * sizeof (BinaryFace));
+      }
+    models.push_back (current);
+  }
+
+
+  void
+  BinaryWriter::close ()
+  {
+    vector< const PropertyType* > sorted;
+    vector< BinaryLabel > entries;
+    vector< uint32_t > offsets;
+    vector< string >::const_iterator nit;
+    BinaryTrailer trailer;
+    unsigned int i;
+    uint32_t poolSize;
+    static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    if (closed)
+      {
+	return;
+      }
+    closed = true;
+
+    // The text report lists the labels of a relation in set order.
+    entries.resize (labels.size ());
+    sorted = labels;
+    sort (sorted.begin (), sorted.end ());
+    for (i = 0; i < labels.size (); ++i)
+      {
+	entries[i].name = getName (labels[i]);
+	entries[i].rank = lower_bound (sorted.begin (), sorted.end (), labels[i]) - sorted.begin ();
+      }
+
+    for (poolSize = 0, nit = names.begin (); names.end () != nit; ++nit)
+      {
+	offsets.push_back (poolSize);
+	poolSize += nit->size () + 1;
+      }
+
+    memset (&trailer, 0, sizeof (trailer));
+    trailer.footer = written;
+    if (! models.empty ())
+      {
+	writeBytes (&models[0], models.size () * sizeof (BinaryModel));
+      }
+    if (! entries.empty ())
+      {
+	writeBytes (&entries[0], entries.size () * sizeof (BinaryLabel));
+      }
+    if (! offsets.empty ())
+      {
+	writeBytes (&offsets[0], offsets.size () * sizeof (uint32_t));
+      }
+    for (nit = names.begin (); names.end () != nit; ++nit)
+      {
+	writeBytes (nit->c_str (), nit->size () + 1);
+      }
+    writeBytes (zeros, (8 - written % 8) % 8);
+
+    trailer.size = written + sizeof (trailer);
+    trailer.nbModels = models.size ();
+    trailer.nbLabels = entries.size ();
+    trailer.nbNames = names.size ();
+    trailer.poolSize = poolSize;
+    memcpy (trailer.magic, BINARY_TRAILER_MAGIC, sizeof (trailer.magic));
+    trailer.version = BINARY_VERSION;
+    writeBytes (&trailer, sizeof (trailer));
+    os.flush ();
+  }
+
+
+  uint32_t
+  BinaryWriter::getName (const string &name)
+  {
+    map< string, uint32_t >::iterator it;
+
+    if (nameIndex.end () == (it = nameIndex.find (name)))
+      {
+	it = nameIndex.insert (make_pair (name, (uint32_t) names.size ())).first;
+	names.push_back (name);
+      }
+    return it->second;
+  }
+
+
+  uint32_t
+  BinaryWriter::getName (const PropertyType *t)
+  {
+    map< const PropertyType*, uint32_t >::iterator it;
+
+    if (propertyIndex.end () == (it = propertyIndex.find (t)))
+      {
+	ostringstream oss;
+
+	oss << t;
+	it = propertyIndex.insert (make_pair (t, getName (oss.str ()))).first;
+      }
+    return it->second;
+  }
+
+
+  void
+  BinaryWriter::writeBytes (const void *data, unsigned long n)
+  {
+    os.write ((const char*) data, n);
+    written += n;
+  }
+
+}
@@ -0,0 +1,195 @@
+//                              -*- Mode: C++ -*-
+// BinaryWriter.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Wed Apr  6 10:18:52 2011
+
+
+#ifndef _annotate_BinaryWriter_h_
+#define _annotate_BinaryWriter_h_
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mccore/PropertyType.h"
+
+#include "BinaryFormat.h"
+#include "LabelTable.h"
+#include "RelationTable.h"
+
+using namespace mccore;
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Writes the binary annotation block of one input file.
+   *
+   * The models are added one at a time, their relations in the storage
+   * order: stacks, links then base pairs.  The dictionaries and the model
+   * index are written by close, or at destruction.  See BinaryFormat.h for
+   * the layout.
+   */
+  class BinaryWriter
+  {
+    /**
+     * The target stream.
+     */
+    ostream &os;
+
+    /**
+     * The number of bytes written to the stream.
+     */
+    uint64_t written;
+
+    /**
+     * Tells if the trailer was written.
+     */
+    bool closed;
+
+    /**
+     * The model index.
+     */
+    vector< BinaryModel > models;
+
+    /**
+     * The name dictionary.
+     */
+    vector< string > names;
+
+    /**
+     * The index of each name.
+     */
+    map< string, uint32_t > nameIndex;
+
+    /**
+     * The name index of the properties already seen.
+     */
+    map< const PropertyType*, uint32_t > propertyIndex;
+
+    /**
+     * The relation labels, in bit order.
+     */
+    vector< const PropertyType* > labels;
+
+    /**
+     * The bit of each relation label.
+     */
+    map< const PropertyType*, uint32_t > labelIndex;
+
+    /**
+     * The residues of the current model.
+     */
+    vector< BinaryResidue > residues;
+
+    /**
+     * The relations of the current model.
+     */
+    vector< BinaryRelation > relations;
+
+    /**
+     * The faces of the current model.
+     */
+    vector< BinaryFace > faces;
+
+    /**
+     * The index entry of the current model.
+     */
+    BinaryModel current;
+
+    /**
+     * The adjacent stacking labels, taken by beginModel.
+     */
+    LabelSet adjacentMask;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    /**
+     * Initializes the object and writes the block header.
+     * @param os the target stream.
+     */
+    BinaryWriter (ostream &os);
+
+    /**
+     * Closes the block and destroys the object.
+     */
+    ~BinaryWriter ();
+
+  private:
+
+    BinaryWriter (const BinaryWriter &right);
+
+    BinaryWriter& operator= (const BinaryWriter &right);
+
+  public:
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Starts a model.
+     * @param model the number of the model in the input file.
+     */
+    void beginModel (unsigned int model);
+
+    /**
+     * Adds a residue to the current model, in vertex label order.
+     * @param resId the residue id text.
+     * @param type the residue type text.
+     * @param nucleic tells if the residue is a nucleic acid, which has a
+     * pucker and a glycosyl.
+     * @param pucker the pucker.
+     * @param glycosyl the glycosyl.
+     */
+    void addResidue (const string &resId, const string &type, bool nucleic,
+		     const PropertyType *pucker, const PropertyType *glycosyl);
+
+    /**
+     * Adds a relation to the current model.
+     * @param kind the relation kind.
+     * @param table the relation table of the model.
+     * @param row the row of the relation in the table.
+     * @param order the label order, giving the labels of the row's ids.
+     * @exception FatalIntLibException when the block has too many labels.
+     */
+    void addRelation (BinaryRelationKind kind, const RelationTable &table, unsigned int row,
+		      const LabelOrder &order);
+
+    /**
+     * Writes the current model.
+     */
+    void endModel ();
+
+    /**
+     * Writes the footer and the trailer.  Nothing more may be written.
+     */
+    void close ();
+
+  private:
+
+    /**
+     * Gets the index of a name, adding it to the dictionary when new.
+     */
+    uint32_t getName (const string &name);
+
+    /**
+     * Gets the name index of a property as the text report writes it.
+     */
+    uint32_t getName (const PropertyType *t);
+
+    /**
+     * Writes raw bytes.
+     */
+    void writeBytes (const void *data, unsigned long n);
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,124 @@
+//                              -*- Mode: C++ -*-
+// LabelTable.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Thu Apr  7 09:52:14 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <algorithm>
+
+#include "mccore/Exception.h"
+
+#include "LabelTable.h"
+
+
+
+namespace annotate
+{
+
+  pthread_mutex_t LabelTable::mutex = PTHREAD_MUTEX_INITIALIZER;
+
+  map< const PropertyType*, unsigned int > LabelTable::ids;
+
+  LabelOrder LabelTable::order;
+
+  map< const PropertyType*, LabelSet > LabelTable::masks;
+
+
+  unsigned int
+  LabelTable::getId (const PropertyType *t)
+  {
+    unsigned int id;
+
+    pthread_mutex_lock (&mutex);
+    id = lockedGetId (t);
+    pthread_mutex_unlock (&mutex);
+    return id;
+  }
+
+
+  LabelSet
+  LabelTable::getMask (const PropertyType *t)
+  {
+    map< const PropertyType*, LabelSet >::iterator it;
+    LabelSet ls;
+
+    pthread_mutex_lock (&mutex);
+    if (masks.end () == (it = masks.find (t)))
+      {
+	map< const PropertyType*, unsigned int >::const_iterator iit;
+
+	for (iit = ids.begin (); ids.end () != iit; ++iit)
+	  {
+	    if (iit->first->is (t))
+	      {
+		ls.set (iit->second);
+	      }
+	  }
+	it = masks.insert (make_pair (t, ls)).first;
+      }
+    ls = it->second;
+    pthread_mutex_unlock (&mutex);
+    return ls;
+  }
+
+
+  LabelSet
+  LabelTable::getSet (const set< const PropertyType* > &labels)
+  {
+    set< const PropertyType* >::const_iterator it;
+    LabelSet ls;
+
+    pthread_mutex_lock (&mutex);
+    for (it = labels.begin (); labels.end () != it; ++it)
+      {
+	ls.set (lockedGetId (*it));
+      }
+    pthread_mutex_unlock (&mutex);
+    return ls;
+  }
+
+
+  void
+  LabelTable::getOrder (LabelOrder &o)
+  {
+    pthread_mutex_lock (&mutex);
+    o = order;
+    pthread_mutex_unlock (&mutex);
+  }
+
+
+  unsigned int
+  LabelTable::lockedGetId (const PropertyType *t)
+  {
+    map< const PropertyType*, unsigned int >::iterator it;
+    map< const PropertyType*, LabelSet >::iterator mit;
+
+    if (ids.end () == (it = ids.find (t)))
+      {
+	if (LabelSet::MAX_LABELS == ids.size ())
+	  {
+	    FatalIntLibException ex ("", __FILE__, __LINE__);
+
+	    pthread_mutex_unlock (&mutex);
+	    ex << "more than " << LabelSet::MAX_LABELS << " relation labels.";
+	    throw ex;
+	  }
+	it = ids.insert (make_pair (t, (unsigned int) ids.size ())).first;
+	order.insert (lower_bound (order.begin (), order.end (), make_pair (t, 0u)),
+		      make_pair (t, it->second));
+	for (mit = masks.begin (); masks.end () != mit; ++mit)
+	  {
+	    if (t->is (mit->first))
+	      {
+		mit->second.set (it->second);
+	      }
+	  }
+      }
+    return it->second;
+  }
+
+}
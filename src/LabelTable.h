@@ -0,0 +1,201 @@
+//                              -*- Mode: C++ -*-
+// LabelTable.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Thu Apr  7 09:52:14 2011
+
+
+#ifndef _annotate_LabelTable_h_
+#define _annotate_LabelTable_h_
+
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "mccore/PropertyType.h"
+
+using namespace mccore;
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Fixed width set of relation labels, one bit per label id.
+   *
+   * The ids are given by the LabelTable.  Tests against a mask of labels
+   * are word ANDs.
+   */
+  class LabelSet
+  {
+  public:
+
+    /**
+     * The maximum number of distinct labels.
+     */
+    static const unsigned int MAX_LABELS = 128;
+
+  private:
+
+    uint64_t bits[MAX_LABELS / 64];
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    LabelSet ()
+    {
+      bits[0] = bits[1] = 0;
+    }
+
+    // OPERATORS ------------------------------------------------------------
+
+    bool operator== (const LabelSet &right) const
+    {
+      return bits[0] == right.bits[0] && bits[1] == right.bits[1];
+    }
+
+    bool operator!= (const LabelSet &right) const
+    {
+      return ! operator== (right);
+    }
+
+    LabelSet operator| (const LabelSet &right) const
+    {
+      LabelSet ls (*this);
+
+      ls.bits[0] |= right.bits[0];
+      ls.bits[1] |= right.bits[1];
+      return ls;
+    }
+
+    // ACCESS ---------------------------------------------------------------
+
+    /**
+     * Tests a label id.
+     */
+    bool test (unsigned int id) const
+    {
+      return 0 != (bits[id / 64] & ((uint64_t) 1 << (id % 64)));
+    }
+
+    /**
+     * Tells if the set is empty.
+     */
+    bool empty () const
+    {
+      return 0 == (bits[0] | bits[1]);
+    }
+
+    /**
+     * Tells if the set holds a label of the mask.
+     */
+    bool intersects (const LabelSet &mask) const
+    {
+      return 0 != ((bits[0] & mask.bits[0]) | (bits[1] & mask.bits[1]));
+    }
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Adds a label id.
+     */
+    void set (unsigned int id)
+    {
+      bits[id / 64] |= (uint64_t) 1 << (id % 64);
+    }
+
+  };
+
+
+  /**
+   * The labels in text report order, the order of a set< const
+   * PropertyType* >, with their ids.
+   */
+  typedef vector< pair< const PropertyType*, unsigned int > > LabelOrder;
+
+
+  /**
+   * @short Process wide dense ids of the relation labels.
+   *
+   * Labels get an id when first seen.  The table is shared by the models
+   * annotated concurrently, so it is protected by a mutex.
+   */
+  class LabelTable
+  {
+    /**
+     * Protects the table.
+     */
+    static pthread_mutex_t mutex;
+
+    /**
+     * The id of each label.
+     */
+    static map< const PropertyType*, unsigned int > ids;
+
+    /**
+     * The masks of the label classes asked for, kept up to date as new
+     * labels get an id.
+     */
+    static map< const PropertyType*, LabelSet > masks;
+
+    /**
+     * The labels, in text report order.
+     */
+    static LabelOrder order;
+
+  public:
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Gets the id of a label, giving it one when it is new.
+     * @param t the label.
+     * @return the id.
+     * @exception FatalIntLibException when there are more than
+     * LabelSet::MAX_LABELS labels.
+     */
+    static unsigned int getId (const PropertyType *t);
+
+    /**
+     * Gets the set of the labels of a class: the labels seen so far that
+     * are t or a subtype of t (t->is), like pSaenger for XIX or pStack for
+     * upward.  A label seen later joins the masks returned afterwards, so
+     * a mask is taken once the labels it is tested against are converted.
+     * @param t the label class.
+     * @return the mask.
+     */
+    static LabelSet getMask (const PropertyType *t);
+
+    /**
+     * Converts the labels of a relation.
+     * @param labels the labels.
+     * @return the label set.
+     */
+    static LabelSet getSet (const set< const PropertyType* > &labels);
+
+    /**
+     * Gets the current labels in text report order.
+     * @param o the labels (output).
+     */
+    static void getOrder (LabelOrder &o);
+
+  private:
+
+    /**
+     * Gets the id of a label, the mutex being locked.  The mutex is
+     * unlocked before the exception is thrown.
+     */
+    static unsigned int lockedGetId (const PropertyType *t);
+
+  };
+
+}
+
+#endif
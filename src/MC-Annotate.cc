@@ -13,7 +13,11 @@
 
 #include <cerrno>
 #include <cstdlib>
+#include <cstring>
+#include <sstream>
 #include <string>
+#include <vector>
+#include <getopt.h>
 #include <unistd.h>
 
 #include "mccore/Binstream.h"
@@ -32,6 +36,13 @@
 #include "mccore/Version.h"
 
 #include "AnnotateModel.h"
+#include "BinaryReader.h"
+#include "BinaryWriter.h"
+#include "ModelArena.h"
+#include "OrderedOutput.h"
+#include "ReferenceIndex.h"
+#include "ResultCache.h"
+#include "TaskPool.h"
 
 using namespace mccore;
 using namespace std;
@@ -42,7 +53,91 @@ unsigned int environment = 0;
 bool oneModel = false;
 unsigned int modelNumber = 0;  // 1 based vector identifier, 0 means all
 ResIdSet residueSelection;
-const char* shortopts = "Vbe:f:hlr:v";
+unsigned int nbJobs = 1;
+unsigned int nbModelJobs = 1;
+bool streaming = false;
+float cellSize = 0;
+unsigned int nbRelationJobs = 1;
+float skin = 0;
+bool useArena = false;
+enum OutputFormat { TEXT_FORMAT, JSONL_FORMAT, BINARY_FORMAT, SNAPSHOT_FORMAT };
+OutputFormat format = TEXT_FORMAT;
+bool decode = false;
+string selectionText;
+string cacheDirectory;
+bool pruneCache = false;
+unsigned long long cacheLimit = 0;
+ResultCache *cache = 0;
+string referenceFile;
+string referenceKey;
+ReferenceIndex *reference = 0;
+const char* shortopts = "T:Vabe:f:g:hj:lp:r:st:v";
+const struct option longopts[] =
+  {
+    { "cache", required_argument, 0, 'C' },
+    { "cache-prune", required_argument, 0, 'P' },
+    { "decode", no_argument, 0, 'D' },
+    { "format", required_argument, 0, 'F' },
+    { "help", no_argument, 0, 'h' },
+    { "reference", required_argument, 0, 'R' },
+    { "version", no_argument, 0, 'V' },
+    { 0, 0, 0, 0 }
+  };
+
+
+
+/**
+ * Destinations of the text produced for one input file.
+ */
+class FileOutput
+{
+public:
+
+  virtual ~FileOutput () { }
+
+  virtual ostream& out () = 0;
+
+  virtual ostream& err () = 0;
+  
+};
+
+
+
+/**
+ * Writes straight to the message streams, for the serial run.
+ */
+class MessageOutput : public FileOutput
+{
+public:
+
+  virtual ostream& out () { return gOut (0); }
+
+  virtual ostream& err () { return gErr (0); }
+
+};
+
+
+
+/**
+ * Keeps the text in private buffers, for the worker threads.
+ */
+class BufferOutput : public FileOutput
+{
+  ostringstream outBuf;
+
+  ostringstream errBuf;
+
+public:
+
+  virtual ostream& out () { return outBuf; }
+
+  virtual ostream& err () { return errBuf; }
+
+  string getOut () const { return outBuf.str (); }
+
+  string getErr () const { return errBuf.str (); }
+
+};
 
 
 
@@ -60,7 +155,7 @@ void
 usage ()
 {
   gOut (0) << "usage: " << PACKAGE_NAME
-	   << " [-bhlvV] [-e num] [-f <model number>] [-r <residue ids>] <structure file> ..."
+	   << " [-abhlsvV] [-e num] [-f <model number>] [-g size] [-j num] [-p num] [-r <residue ids>] [-t num] [-T skin] [--format fmt] [--decode] [--cache dir [--cache-prune size]] [--reference file] <structure file> ..."
 	   << endl;
 }
 
@@ -70,14 +165,39 @@ help ()
 {
   gOut (0)
     << "This program annotate structures (and more)." << endl
+    << "  -a                allocate the objects of each model (of each file without -s)" << endl
+    << "                    from an arena released at once" << endl
     << "  -b                read binary files instead of pdb files" << endl
     << "  -e num            number of surrounding layers of connected residues to annotate" << endl
     << "  -f model number   model to print" << endl
+    << "  -g size           edge of the spatial grid cells in Angstroms (default automatic)" << endl
     << "  -h                print this help" << endl
+    << "  -j num            number of files annotated in parallel (default 1)" << endl
     << "  -l                be more verbose (log)" << endl
+    << "  -p num            number of threads computing the relations of a model (default 1)" << endl
     << "  -r sel            extract these residues from the structure" << endl 
+    << "  -s                read pdb files one model at a time (constant memory)" << endl
+    << "  -t num            number of models of a file annotated in parallel (default 1)" << endl
+    << "  -T skin           trajectory mode: reuse the residue neighbor lists of the" << endl
+    << "                    previous models, with this skin distance in Angstroms" << endl
     << "  -v                be verbose" << endl
-    << "  -V                print the software version info" << endl;    
+    << "  -V                print the software version info" << endl
+    << "  --format fmt      output format: text (default); jsonl, one JSON record" << endl
+    << "                    per residue, stack, link and base pair; or binary, a" << endl
+    << "                    mappable columnar file (see BinaryFormat.h); or snapshot," << endl
+    << "                    the annotated models of one file, reloaded with -b" << endl
+    << "                    without recomputing the relations" << endl
+    << "  --decode          print binary annotation files as the text report" << endl
+    << "  --cache dir       reuse the outputs stored in this directory for identical" << endl
+    << "                    input files and options, and store the new ones" << endl
+    << "  --cache-prune size  evict the least recently used outputs of the cache until" << endl
+    << "                    it holds at most size bytes (suffixes k, M and G), input" << endl
+    << "                    files are then optional" << endl
+    << "  --reference file  score the models against the first model of this file" << endl
+    << "                    instead of printing their annotation: one line per model" << endl
+    << "                    with the INF, PPV, STY, TP, FP and FN of all the" << endl
+    << "                    interactions, the canonical pairs, the other pairs and" << endl
+    << "                    the stacks (text or jsonl format)" << endl;    
 }
 
 
@@ -86,14 +206,92 @@ read_options (int argc, char* argv[])
 {
   int c;
 
-  while ((c = getopt (argc, argv, shortopts)) != EOF) 
+  while ((c = getopt_long (argc, argv, shortopts, longopts, 0)) != EOF) 
     {
       switch (c)
 	{
+	case 'C':
+	  cacheDirectory = optarg;
+	  break;
+	case 'D':
+	  decode = true;
+	  break;
+	case 'F':
+	  if (0 == strcmp (optarg, "text"))
+	    {
+	      format = TEXT_FORMAT;
+	    }
+	  else if (0 == strcmp (optarg, "jsonl"))
+	    {
+	      format = JSONL_FORMAT;
+	    }
+	  else if (0 == strcmp (optarg, "binary"))
+	    {
+	      format = BINARY_FORMAT;
+	    }
+	  else if (0 == strcmp (optarg, "snapshot"))
+	    {
+	      format = SNAPSHOT_FORMAT;
+	    }
+	  else
+	    {
+	      gErr (0) << PACKAGE_NAME << ": invalid output format." << endl;
+	      exit (EXIT_FAILURE);
+	    }
+	  break;
+	case 'P':
+	  {
+	    double tmp;
+	    char *end;
+
+	    tmp = strtod (optarg, &end);
+	    switch (*end)
+	      {
+	      case 'G': tmp *= 1024;
+	      case 'M': tmp *= 1024;
+	      case 'k': tmp *= 1024;
+	      case '\0': break;
+	      default: tmp = -1;
+	      }
+	    if (ERANGE == errno
+		|| 0 > tmp)
+	      {
+		gErr (0) << PACKAGE_NAME << ": invalid cache size." << endl;
+		exit (EXIT_FAILURE);
+	      }
+	    cacheLimit = (unsigned long long) tmp;
+	    pruneCache = true;
+	    break;
+	  }
+	case 'R':
+	  referenceFile = optarg;
+	  break;
+	case 'T':
+	  {
+	    double tmp;
+
+	    tmp = strtod (optarg, 0);
+	    if (ERANGE == errno
+		|| 0 >= tmp)
+	      {
+		gErr (0) << PACKAGE_NAME << ": invalid skin distance." << endl;
+		exit (EXIT_FAILURE);
+	      }
+	    skin = tmp;
+	    break;
+	  }
         case 'V':
           version ();
           exit (EXIT_SUCCESS);
           break;
+	case 'a':
+	  if (! ModelArena::isEnabled ())
+	    {
+	      gErr (0) << PACKAGE_NAME << ": built without the arena allocator." << endl;
+	      exit (EXIT_FAILURE);
+	    }
+	  useArena = true;
+	  break;
 	case 'b':
 	  binary = true;
 	  break; 
@@ -128,18 +326,63 @@ read_options (int argc, char* argv[])
 	    oneModel = true;
 	    break;
 	  }
+	case 'g':
+	  {
+	    double tmp;
+
+	    tmp = strtod (optarg, 0);
+	    if (ERANGE == errno
+		|| 0 > tmp)
+	      {
+		gErr (0) << PACKAGE_NAME << ": invalid grid cell size." << endl;
+		exit (EXIT_FAILURE);
+	      }
+	    cellSize = tmp;
+	    break;
+	  }
         case 'h':
           usage ();
           help ();
           exit (EXIT_SUCCESS);
           break;
+	case 'j':
+	  {
+	    long int tmp;
+
+	    tmp = strtol (optarg, 0, 10);
+	    if (ERANGE == errno
+		|| EINVAL == errno
+		|| 1 > tmp)
+	      {
+		gErr (0) << PACKAGE_NAME << ": invalid number of jobs." << endl;
+		exit (EXIT_FAILURE);
+	      }
+	    nbJobs = tmp;
+	    break;
+	  }
         case 'l':
           gErr.setVerboseLevel (gErr.getVerboseLevel () + 1);
           break;
+	case 'p':
+	  {
+	    long int tmp;
+
+	    tmp = strtol (optarg, 0, 10);
+	    if (ERANGE == errno
+		|| EINVAL == errno
+		|| 1 > tmp)
+	      {
+		gErr (0) << PACKAGE_NAME << ": invalid number of relation jobs." << endl;
+		exit (EXIT_FAILURE);
+	      }
+	    nbRelationJobs = tmp;
+	    break;
+	  }
 	case 'r':
 	  try
 	    {
 	      residueSelection.insert (optarg);
+	      selectionText.append (optarg).append (" ");
 	    }
 	  catch (IntLibException &e)
 	    {
@@ -147,6 +390,24 @@ read_options (int argc, char* argv[])
 	      exit (EXIT_FAILURE);
 	    }
 	  break;
+	case 's':
+	  streaming = true;
+	  break;
+	case 't':
+	  {
+	    long int tmp;
+
+	    tmp = strtol (optarg, 0, 10);
+	    if (ERANGE == errno
+		|| EINVAL == errno
+		|| 1 > tmp)
+	      {
+		gErr (0) << PACKAGE_NAME << ": invalid number of model jobs." << endl;
+		exit (EXIT_FAILURE);
+	      }
+	    nbModelJobs = tmp;
+	    break;
+	  }
 	case 'v':
 	  gOut.setVerboseLevel (gOut.getVerboseLevel () + 1);
           break;
@@ -156,7 +417,18 @@ read_options (int argc, char* argv[])
 	}
     }
 
-  if (argc - optind < 1)
+  if (pruneCache && cacheDirectory.empty ())
+    {
+      gErr (0) << PACKAGE_NAME << ": --cache-prune needs a --cache directory." << endl;
+      exit (EXIT_FAILURE);
+    }
+  if (! referenceFile.empty ()
+      && (BINARY_FORMAT == format || SNAPSHOT_FORMAT == format || decode))
+    {
+      gErr (0) << PACKAGE_NAME << ": --reference needs the text or jsonl format." << endl;
+      exit (EXIT_FAILURE);
+    }
+  if (argc - optind < 1 && ! pruneCache)
     {
       usage ();
       exit (EXIT_FAILURE);
@@ -165,12 +437,16 @@ read_options (int argc, char* argv[])
 
 
 mccore::Molecule*
-loadFile (const string &filename)
+loadFile (const string &filename, ostream &err)
 {
+  // Parsing may register new types in mccore, see TaskPool.
+  SerialSection section;
   Molecule *molecule;
   ResidueFM rFM;
   AnnotateModelFM aFM (residueSelection, environment, &rFM);
 
+  aFM.setCellSize (cellSize);
+  aFM.setNbThreads (nbRelationJobs);
   molecule = 0;
   if (binary)
     {
@@ -179,7 +455,7 @@ loadFile (const string &filename)
       in.open (filename.c_str ());
       if (in.fail ())
 	{
-	  gErr (0) << PACKAGE_NAME << ": cannot open binary file '" << filename << "'." << endl;
+	  err << PACKAGE_NAME << ": cannot open binary file '" << filename << "'." << endl;
 	  return 0;
 	}
       molecule = new Molecule (&aFM);
@@ -199,7 +475,7 @@ loadFile (const string &filename)
 	  in.open (filename.c_str ());
 	  if (in.fail ())
 	    {
-	      gErr (0) << PACKAGE_NAME << ": cannot open pdb file '" << filename << "'." << endl;
+	      err << PACKAGE_NAME << ": cannot open pdb file '" << filename << "'." << endl;
 	      return 0;
 	    }
 	  molecule = new Molecule (&aFM);
@@ -213,40 +489,675 @@ loadFile (const string &filename)
 }
 
 
-int
-main (int argc, char *argv[])
+/**
+ * Logs the spatial pruning statistics of an annotated model (-l).
+ */
+void
+logModel (const AnnotateModel &am, ostream &err)
 {
-  read_options (argc, argv);
+  if (0 < gErr.getVerboseLevel ())
+    {
+      err << PACKAGE_NAME << ": " << am.getNbPrunedPairs () << " of "
+	  << am.getNbPairs () << " residue pairs pruned by the spatial grid."
+	  << endl;
+    }
+}
+
+
+/**
+ * Creates the binary block writer of a file (--format binary).
+ * @param os the output stream.
+ * @return the writer, null for the text formats.
+ */
+BinaryWriter*
+createBinaryWriter (ostream &os)
+{
+  return BINARY_FORMAT == format ? new BinaryWriter (os) : 0;
+}
+
+
+/**
+ * Opens the snapshot stream of a file (--format snapshot).
+ * @param os the output stream.
+ * @return the snapshot stream, null for the other formats.
+ */
+oBinstream*
+createSnapshotStream (ostream &os)
+{
+  oBinstream *obs = 0;
+
+  if (SNAPSHOT_FORMAT == format)
+    {
+      obs = new oBinstream (os.rdbuf ());
+      AnnotateModel::writeSnapshotHeader (*obs);
+    }
+  return obs;
+}
+
+
+/**
+ * Ends and deletes a snapshot stream, the model number 0 closing it.
+ * @param obs the snapshot stream, may be null.
+ */
+void
+closeSnapshotStream (oBinstream *obs)
+{
+  if (0 != obs)
+    {
+      *obs << 0u;
+      obs->flush ();
+      delete obs;
+    }
+}
+
+
+/**
+ * Writes an annotated model in the selected output format.
+ * @param am the annotated model.
+ * @param filename the input file name.
+ * @param model the 1 based number of the model in the file.
+ * @param os the output stream.
+ * @param bw the binary block writer of the file, used for binary output.
+ * @param obs the snapshot stream of the file, used for snapshot output.
+ */
+void
+writeModel (const AnnotateModel &am, const string &filename, unsigned int model,
+	    ostream &os, BinaryWriter *bw, oBinstream *obs)
+{
+  if (0 != reference)
+    {
+      ReferenceIndex::Scores scores;
+
+      reference->compare (am, scores);
+      if (JSONL_FORMAT == format)
+	{
+	  ReferenceIndex::outputJsonl (os, filename, model, scores);
+	}
+      else
+	{
+	  ReferenceIndex::output (os, filename, model, scores);
+	}
+    }
+  else if (BINARY_FORMAT == format)
+    {
+      am.outputBinary (*bw, model);
+    }
+  else if (SNAPSHOT_FORMAT == format)
+    {
+      *obs << model;
+      am.writeSnapshot (*obs);
+    }
+  else if (JSONL_FORMAT == format)
+    {
+      am.outputJsonl (os, filename, model);
+    }
+  else
+    {
+      os << am;
+    }
+}
+
+
+/**
+ * Creates the trajectory neighbor list of a file (-T).
+ * @return the neighbor list, null when not in trajectory mode.
+ */
+NeighborList*
+createNeighborList ()
+{
+  return (0 < skin
+	  ? new NeighborList (AnnotateModel::getContactCutoff (), skin, cellSize)
+	  : 0);
+}
+
+
+/**
+ * Logs the neighbor list reuse of a file's trajectory (-T, -l).
+ */
+void
+logNeighborList (const NeighborList *nl, ostream &err)
+{
+  if (0 != nl && 0 < gErr.getVerboseLevel ())
+    {
+      err << PACKAGE_NAME << ": neighbor list built " << nl->getNbRebuilds ()
+	  << " times for " << nl->getNbFrames () << " models." << endl;
+    }
+}
+
+
+/**
+ * Logs the memory use of an arena (-a, -l).
+ */
+void
+logArena (const ModelArena &arena, ostream &err)
+{
+  if (useArena && 0 < gErr.getVerboseLevel ())
+    {
+      err << PACKAGE_NAME << ": " << arena.getAllocated () / 1024 << " KiB allocated in "
+	  << arena.getNbChunks () << " arena chunks, RSS grown by "
+	  << arena.getRssGrowth () << " KiB." << endl;
+    }
+}
+
+
+/**
+ * Skips the given number of models of a pdb stream by scanning for ENDMDL
+ * records, without building any residue.
+ * @param in the pdb stream.
+ * @param nb the number of models to skip.
+ * @return false if the stream ended before the models were skipped.
+ */
+bool
+skipModels (iPdbstream &in, unsigned int nb)
+{
+  string line;
+  
+  while (0 != nb && getline (in, line))
+    {
+      if (0 == line.compare (0, 6, "ENDMDL"))
+	{
+	  --nb;
+	}
+    }
+  return 0 == nb;
+}
+
 
-  while (optind < argc)
+/**
+ * Reads, annotates, prints and frees the models of a pdb file one at a
+ * time, so that memory use does not depend on the number of models.
+ */
+void
+streamFile (const string &filename, FileOutput &fo)
+{
+  ResidueFM rFM;
+  AnnotateModelFM aFM (residueSelection, environment, &rFM);
+  izfPdbstream in;
+  NeighborList *nl;
+  BinaryWriter *bw;
+  oBinstream *obs;
+  unsigned int model = modelNumber;
+
+  aFM.setCellSize (cellSize);
+  aFM.setNbThreads (nbRelationJobs);
+  in.open (filename.c_str ());
+  if (in.fail ())
+    {
+      fo.err () << PACKAGE_NAME << ": cannot open pdb file '" << filename << "'." << endl;
+      return;
+    }
+  nl = createNeighborList ();
+  bw = createBinaryWriter (fo.out ());
+  obs = createSnapshotStream (fo.out ());
+  if (skipModels (in, modelNumber))
+    {
+      // A read error sets failbit without eofbit, so eof alone would loop.
+      while (in.good ())
+	{
+	  ModelArena arena;
+	  bool done = false;
+
+	  {
+	    ArenaScope scope (useArena ? &arena : 0);
+	    AnnotateModel *am = (AnnotateModel*) aFM.createModel ();
+
+	    {
+	      SerialSection section;
+
+	      in >> *am;
+	    }
+	    ++model;
+	    if (0 != am->size ())
+	      {
+		am->setNeighborList (nl);
+		am->annotate ();
+		logModel (*am, fo.err ());
+		writeModel (*am, filename, model, fo.out (), bw, obs);
+		done = oneModel;
+	      }
+	    delete am;
+	  }
+	  if (0 != arena.getAllocated ())
+	    {
+	      logArena (arena, fo.err ());
+	    }
+	  if (done)
+	    {
+	      break;
+	    }
+	}
+    }
+  in.close ();
+  logNeighborList (nl, fo.err ());
+  delete nl;
+  delete bw;
+  closeSnapshotStream (obs);
+}
+
+
+/**
+ * Annotates the models of a molecule concurrently.  Each model's text is
+ * produced in a private buffer and written in model order.  The binary
+ * and snapshot formats are written afterwards, by the caller.
+ */
+class ModelTask : public Task
+{
+  const vector< AnnotateModel* > &models;
+
+  const string &filename;
+
+  OrderedOutput &output;
+
+public:
+
+  ModelTask (const vector< AnnotateModel* > &m, const string &f, OrderedOutput &o)
+    : models (m), filename (f), output (o)
+  { }
+
+  virtual void run (unsigned int index)
+  {
+    ostringstream oss;
+    ostringstream ess;
+
+    models[index]->annotate ();
+    logModel (*models[index], ess);
+    if (BINARY_FORMAT != format && SNAPSHOT_FORMAT != format)
+      {
+	writeModel (*models[index], filename, modelNumber + index + 1, oss, 0, 0);
+      }
+    output.post (index, oss.str (), ess.str ());
+  }
+
+};
+
+
+/**
+ * Tells if a binary file is an annotation snapshot (--format snapshot).
+ */
+bool
+isSnapshot (const string &filename)
+{
+  izfBinstream in;
+  bool snapshot;
+
+  in.open (filename.c_str ());
+  if (in.fail ())
+    {
+      return false;
+    }
+  snapshot = 0 != AnnotateModel::readSnapshotHeader (in);
+  in.close ();
+  return snapshot;
+}
+
+
+/**
+ * Prints the models of an annotation snapshot in the selected output
+ * format.  The models are read one at a time and are not annotated again.
+ */
+void
+restoreFile (const string &filename, FileOutput &fo)
+{
+  ResidueFM rFM;
+  AnnotateModelFM aFM (residueSelection, environment, &rFM);
+  izfBinstream in;
+  BinaryWriter *bw;
+  oBinstream *obs;
+  unsigned int version;
+  unsigned int model;
+  unsigned int skip = modelNumber;
+
+  in.open (filename.c_str ());
+  if (in.fail ())
+    {
+      fo.err () << PACKAGE_NAME << ": cannot open binary file '" << filename << "'." << endl;
+      return;
+    }
+  if (AnnotateModel::SNAPSHOT_VERSION != (version = AnnotateModel::readSnapshotHeader (in)))
+    {
+      fo.err () << PACKAGE_NAME << ": unsupported snapshot version " << version
+		<< " in '" << filename << "'." << endl;
+      return;
+    }
+  bw = createBinaryWriter (fo.out ());
+  obs = createSnapshotStream (fo.out ());
+  try
+    {
+      while (in >> model, in.good () && 0 != model)
+	{
+	  ModelArena arena;
+	  bool done = false;
+
+	  {
+	    ArenaScope scope (useArena ? &arena : 0);
+	    AnnotateModel *am = (AnnotateModel*) aFM.createModel ();
+
+	    {
+	      SerialSection section;
+
+	      am->readSnapshot (in);
+	    }
+	    if (0 != skip)
+	      {
+		--skip;
+	      }
+	    else
+	      {
+		writeModel (*am, filename, model, fo.out (), bw, obs);
+		done = oneModel;
+	      }
+	    delete am;
+	  }
+	  logArena (arena, fo.err ());
+	  if (done)
+	    {
+	      break;
+	    }
+	}
+    }
+  catch (IntLibException &e)
     {
-      Molecule *molecule;
-      Molecule::iterator molIt;
+      fo.err () << PACKAGE_NAME << ": corrupted snapshot '" << filename << "'." << endl;
+    }
+  in.close ();
+  delete bw;
+  closeSnapshotStream (obs);
+}
+
+
+void
+annotateFile (const string &filename, FileOutput &fo)
+{
+  Molecule *molecule;
+  Molecule::iterator molIt;
+  unsigned int skip = modelNumber;
+  ModelArena arena;
+
+  if (streaming && ! binary)
+    {
+      streamFile (filename, fo);
+      return;
+    }
+  if (binary && isSnapshot (filename))
+    {
+      restoreFile (filename, fo);
+      return;
+    }
+  ArenaScope scope (useArena ? &arena : 0);
+  molecule = loadFile (filename, fo.err ());
+  if (0 != molecule)
+    {
+      vector< AnnotateModel* > models;
+      vector< AnnotateModel* >::iterator amIt;
       
-      molecule = loadFile ((string) argv[optind]);
-      if (0 != molecule)
+      for (molIt = molecule->begin (); molecule->end () != molIt; ++molIt)
 	{
-	  for (molIt = molecule->begin (); molecule->end () != molIt; ++molIt)
+	  if (0 != skip)
 	    {
-	      if (0 != modelNumber)
+	      --skip;
+	    }
+	  else
+	    {
+	      models.push_back ((AnnotateModel*) &*molIt);
+	      if (oneModel)
 		{
-		  --modelNumber;
+		  break;
 		}
-	      else
+	    }
+	}
+      // Trajectory frames depend on their predecessor's neighbor list.
+      if (1 < nbModelJobs && 1 < models.size () && 0 == skin)
+	{
+	  TaskPool pool (nbModelJobs);
+	  OrderedOutput output (fo.out (), fo.err ());
+	  ModelTask task (models, filename, output);
+
+	  pool.run (task, models.size ());
+	  if (BINARY_FORMAT == format || SNAPSHOT_FORMAT == format)
+	    {
+	      BinaryWriter *bw = createBinaryWriter (fo.out ());
+	      oBinstream *obs = createSnapshotStream (fo.out ());
+
+	      for (amIt = models.begin (); models.end () != amIt; ++amIt)
 		{
-		  AnnotateModel &am = (AnnotateModel&) *molIt;
-		  
-		  am.annotate ();
-		  gOut(0) << am;
-		  if (oneModel)
-		    {
-		      break;
-		    }
+		  writeModel (**amIt, filename, modelNumber + (amIt - models.begin ()) + 1,
+			      fo.out (), bw, obs);
 		}
+	      delete bw;
+	      closeSnapshotStream (obs);
 	    }
-	  delete molecule;
 	}
-      ++optind;
+      else
+	{
+	  NeighborList *nl = createNeighborList ();
+	  BinaryWriter *bw = createBinaryWriter (fo.out ());
+	  oBinstream *obs = createSnapshotStream (fo.out ());
+
+	  for (amIt = models.begin (); models.end () != amIt; ++amIt)
+	    {
+	      (*amIt)->setNeighborList (nl);
+	      (*amIt)->annotate ();
+	      logModel (**amIt, fo.err ());
+	      writeModel (**amIt, filename, modelNumber + (amIt - models.begin ()) + 1,
+			  fo.out (), bw, obs);
+	    }
+	  logNeighborList (nl, fo.err ());
+	  delete nl;
+	  delete bw;
+	  closeSnapshotStream (obs);
+	}
+      delete molecule;
+    }
+  logArena (arena, fo.err ());
+}
+
+
+
+/**
+ * Describes the options changing the output of a file, for the result
+ * cache keys.  The JSON Lines records and the reference scores name the
+ * input file, so its path is then part of the key.
+ * @param filename the input file name.
+ */
+string
+getCacheOptions (const string &filename)
+{
+  ostringstream oss;
+  mccore::Version mccorev;
+
+  oss << PACKAGE_NAME << " " << PACKAGE_VERSION_STRING << endl
+      << mccorev << endl
+      << "-e " << environment << endl
+      << "-r " << selectionText << endl
+      << "-f " << (oneModel ? (long) modelNumber : -1L) << endl
+      << "-b " << binary << endl
+      << "--format " << format << endl
+      << "--reference " << referenceKey << endl;
+  if (JSONL_FORMAT == format || 0 != reference)
+    {
+      oss << "file " << filename << endl;
+    }
+  return oss.str ();
+}
+
+
+/**
+ * Annotates a file through the result cache (--cache): the stored output
+ * of an identical file is written without reading the structure, and a
+ * new output is stored once written.
+ */
+void
+processFile (const string &filename, FileOutput &fo)
+{
+  string key;
+
+  if (0 == cache || ! ResultCache::makeKey (filename, getCacheOptions (filename), key))
+    {
+      annotateFile (filename, fo);
+    }
+  else if (! cache->fetch (key, fo.out ()))
+    {
+      BufferOutput bo;
+      string out;
+
+      annotateFile (filename, bo);
+      out = bo.getOut ();
+      fo.out ().write (out.data (), out.size ());
+      fo.err () << bo.getErr ();
+      // A file that cannot be read gives no output.
+      if (! out.empty ())
+	{
+	  cache->store (key, out);
+	}
+    }
+}
+
+
+
+/**
+ * Prints the models of a binary annotation file as the text report.
+ */
+void
+decodeFile (const string &filename, FileOutput &fo)
+{
+  BinaryReader reader;
+  unsigned int block;
+  unsigned int model;
+
+  if (! reader.open (filename))
+    {
+      fo.err () << PACKAGE_NAME << ": cannot read binary annotation file '" << filename << "'." << endl;
+      return;
+    }
+  for (block = 0; block < reader.getNbBlocks (); ++block)
+    {
+      for (model = 0; model < reader.getNbModels (block); ++model)
+	{
+	  reader.outputText (fo.out (), block, model);
+	}
+    }
+  fo.out () << flush;
+}
+
+
+
+/**
+ * Annotates the input files concurrently, each worker writing to its own
+ * buffers.  The buffers are written in command line order.
+ */
+class FileTask : public Task
+{
+  char **files;
+
+  OrderedOutput &output;
+
+public:
+
+  FileTask (char **f, OrderedOutput &o) : files (f), output (o) { }
+
+  virtual void run (unsigned int index)
+  {
+    BufferOutput bo;
+
+    processFile ((string) files[index], bo);
+    output.post (index, bo.getOut (), bo.getErr ());
+  }
+
+};
+
+
+/**
+ * Annotates the first model of the reference file and indexes its
+ * interactions (--reference).
+ * @return false if the file cannot be read.
+ */
+bool
+loadReference ()
+{
+  Molecule *molecule;
+
+  if (0 == (molecule = loadFile (referenceFile, gErr (0))))
+    {
+      return false;
+    }
+  if (molecule->begin () == molecule->end ())
+    {
+      gErr (0) << PACKAGE_NAME << ": no model in reference file '" << referenceFile << "'." << endl;
+      delete molecule;
+      return false;
+    }
+  AnnotateModel &am = (AnnotateModel&) *molecule->begin ();
+
+  am.annotate ();
+  logModel (am, gErr (0));
+  reference = new ReferenceIndex ();
+  reference->build (am);
+  delete molecule;
+  // The cached scores depend on the reference content.
+  if (! ResultCache::makeKey (referenceFile, "", referenceKey))
+    {
+      referenceKey = referenceFile;
+    }
+  if (0 < gErr.getVerboseLevel ())
+    {
+      gErr (0) << PACKAGE_NAME << ": reference '" << referenceFile << "' indexed, "
+	       << reference->getNbInteractions (ReferenceIndex::ALL) << " interactions." << endl;
+    }
+  return true;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  read_options (argc, argv);
+
+  if (! cacheDirectory.empty ())
+    {
+      cache = new ResultCache (cacheDirectory);
+    }
+  if (! referenceFile.empty () && ! loadReference ())
+    {
+      return EXIT_FAILURE;
+    }
+  if (decode)
+    {
+      MessageOutput mo;
+
+      while (optind < argc)
+	{
+	  decodeFile ((string) argv[optind], mo);
+	  ++optind;
+	}
+    }
+  else if (1 < nbJobs && 1 < argc - optind)
+    {
+      TaskPool pool (nbJobs);
+      OrderedOutput output;
+      FileTask task (argv + optind, output);
+
+      pool.run (task, argc - optind);
+    }
+  else
+    {
+      MessageOutput mo;
+      
+      while (optind < argc)
+	{
+	  processFile ((string) argv[optind], mo);
+	  ++optind;
+	}
+    }
+  if (pruneCache)
+    {
+      unsigned int removed = cache->prune (cacheLimit);
+
+      if (0 < gErr.getVerboseLevel ())
+	{
+	  gErr (0) << PACKAGE_NAME << ": " << removed << " outputs evicted from the cache." << endl;
+	}
     }
+  delete cache;
+  delete reference;
   return EXIT_SUCCESS;	
 }
@@ -0,0 +1,363 @@
+//                              -*- Mode: C++ -*-
+// ModelArena.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Tue Apr 12 10:44:03 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <cstdlib>
+#include <new>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "ModelArena.h"
+
+
+
+namespace annotate
+{
+
+  /**
+   * The header of a chunk, followed by its objects.  The live count
+   * includes one reference held by the arena while it fills the chunk.
+   */
+  struct ArenaChunk
+  {
+    volatile long live;
+    size_t size;
+    char *next;
+    char *end;
+    ArenaChunk *link;
+    char padding[24];
+  };
+
+
+  /**
+   * The size of the header in front of every object.  It holds the chunk
+   * of an arena object, null for a malloc object, and keeps the 16 bytes
+   * alignment.
+   */
+  static const size_t OBJECT_HEADER = 16;
+
+  /**
+   * The number of free standard chunks kept for reuse.
+   */
+  static const unsigned int POOL_MAX = 64;
+
+  static pthread_mutex_t poolMutex = PTHREAD_MUTEX_INITIALIZER;
+
+  static ArenaChunk *pool = 0;
+
+  static unsigned int poolSize = 0;
+
+  static __thread ModelArena *current = 0;
+
+
+  static ArenaChunk*
+  takeChunk (size_t size)
+  {
+    ArenaChunk *c = 0;
+
+    if (ModelArena::CHUNK_SIZE == size)
+      {
+	pthread_mutex_lock (&poolMutex);
+	if (0 != (c = pool))
+	  {
+	    pool = c->link;
+	    --poolSize;
+	  }
+	pthread_mutex_unlock (&poolMutex);
+      }
+    if (0 == c && 0 == (c = (ArenaChunk*) malloc (size)))
+      {
+	throw std::bad_alloc ();
+      }
+    c->live = 1;
+    c->size = size;
+    c->next = (char*) c + sizeof (ArenaChunk);
+    c->end = (char*) c + size;
+    c->link = 0;
+    return c;
+  }
+
+
+  static void
+  giveChunk (ArenaChunk *c)
+  {
+    if (ModelArena::CHUNK_SIZE == c->size)
+      {
+	pthread_mutex_lock (&poolMutex);
+	if (POOL_MAX > poolSize)
+	  {
+	    c->link = pool;
+	    pool = c;
+	    ++poolSize;
+	    c = 0;
+	  }
+	pthread_mutex_unlock (&poolMutex);
+      }
+    free (c);
+  }
+
+
+  static void
+  unref (ArenaChunk *c)
+  {
+    if (0 == __sync_sub_and_fetch (&c->live, 1))
+      {
+	giveChunk (c);
+      }
+  }
+
+
+  ModelArena::ModelArena ()
+    : chunk (0),
+      allocated (0),
+      nbChunks (0),
+      startRss (0),
+      peakRss (0)
+  { }
+
+
+  ModelArena::~ModelArena ()
+  {
+    retire ();
+  }
+
+
+  ModelArena*
+  ModelArena::getCurrent ()
+  {
+    return current;
+  }
+
+
+  bool
+  ModelArena::isEnabled ()
+  {
+#ifdef ARENA_ALLOCATOR
+    return true;
+#else
+    return false;
+#endif
+  }
+
+
+  long
+  ModelArena::getRss ()
+  {
+    // Read without the streams: they would allocate from the arena being
+    // filled.
+    char buffer[64];
+    char *p;
+    ssize_t n;
+    long pages;
+    int fd;
+
+    if (0 > (fd = open ("/proc/self/statm", O_RDONLY)))
+      {
+	return 0;
+      }
+    n = read (fd, buffer, sizeof (buffer) - 1);
+    close (fd);
+    if (0 >= n)
+      {
+	return 0;
+      }
+    buffer[n] = '\0';
+    strtol (buffer, &p, 10);
+    pages = strtol (p, 0, 10);
+    return pages * (sysconf (_SC_PAGESIZE) / 1024);
+  }
+
+
+  void*
+  ModelArena::allocate (size_t n)
+  {
+    size_t size = OBJECT_HEADER + ((n + 15) & ~(size_t) 15);
+    char *p;
+
+    if (0 == chunk || (size_t) (chunk->end - chunk->next) < size)
+      {
+	long rss = getRss ();
+
+	if (0 == nbChunks)
+	  {
+	    startRss = peakRss = rss;
+	  }
+	else if (peakRss < rss)
+	  {
+	    peakRss = rss;
+	  }
+	retire ();
+	chunk = takeChunk (sizeof (ArenaChunk) + size > CHUNK_SIZE
+			   ? sizeof (ArenaChunk) + size
+			   : CHUNK_SIZE);
+	++nbChunks;
+      }
+    p = chunk->next;
+    chunk->next += size;
+    __sync_add_and_fetch (&chunk->live, 1);
+    allocated += size;
+    *(ArenaChunk**) p = chunk;
+    return p + OBJECT_HEADER;
+  }
+
+
+  bool
+  ModelArena::release (void *p)
+  {
+    ArenaChunk *c = *(ArenaChunk**) ((char*) p - OBJECT_HEADER);
+
+    if (0 == c)
+      {
+	return false;
+      }
+    unref (c);
+    return true;
+  }
+
+
+  void
+  ModelArena::retire ()
+  {
+    if (0 != chunk)
+      {
+	unref (chunk);
+	chunk = 0;
+      }
+  }
+
+
+  ArenaScope::ArenaScope (ModelArena *arena)
+    : previous (current)
+  {
+    current = arena;
+  }
+
+
+  ArenaScope::~ArenaScope ()
+  {
+    current = previous;
+  }
+
+}
+
+
+#ifdef ARENA_ALLOCATOR
+
+#if __cplusplus >= 201103L
+# define ARENA_THROW_BAD_ALLOC
+# define ARENA_NOTHROW noexcept
+#else
+# define ARENA_THROW_BAD_ALLOC throw (std::bad_alloc)
+# define ARENA_NOTHROW throw ()
+#endif
+
+// The global allocation functions.  Every block starts with the header
+// telling its origin, so a delete finds out whether it goes to free or to
+// an arena chunk.
+
+static void*
+arenaNew (size_t n)
+{
+  annotate::ModelArena *arena = annotate::ModelArena::getCurrent ();
+  char *p;
+
+  if (0 != arena)
+    {
+      return arena->allocate (n);
+    }
+  if (0 == (p = (char*) malloc (annotate::OBJECT_HEADER + n)))
+    {
+      return 0;
+    }
+  *(annotate::ArenaChunk**) p = 0;
+  return p + annotate::OBJECT_HEADER;
+}
+
+
+static void
+arenaDelete (void *p)
+{
+  if (0 != p && ! annotate::ModelArena::release (p))
+    {
+      free ((char*) p - annotate::OBJECT_HEADER);
+    }
+}
+
+
+void*
+operator new (size_t n) ARENA_THROW_BAD_ALLOC
+{
+  void *p;
+
+  if (0 == (p = arenaNew (n)))
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+
+void*
+operator new[] (size_t n) ARENA_THROW_BAD_ALLOC
+{
+  return operator new (n);
+}
+
+
+void*
+operator new (size_t n, const std::nothrow_t&) ARENA_NOTHROW
+{
+  try
+    {
+      return arenaNew (n);
+    }
+  catch (std::bad_alloc&)
+    {
+      return 0;
+    }
+}
+
+
+void*
+operator new[] (size_t n, const std::nothrow_t &nt) ARENA_NOTHROW
+{
+  return operator new (n, nt);
+}
+
+
+void
+operator delete (void *p) ARENA_NOTHROW
+{
+  arenaDelete (p);
+}
+
+
+void
+operator delete[] (void *p) ARENA_NOTHROW
+{
+  arenaDelete (p);
+}
+
+
+void
+operator delete (void *p, const std::nothrow_t&) ARENA_NOTHROW
+{
+  arenaDelete (p);
+}
+
+
+void
+operator delete[] (void *p, const std::nothrow_t&) ARENA_NOTHROW
+{
+  arenaDelete (p);
+}
+
+#endif
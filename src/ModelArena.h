@@ -0,0 +1,187 @@
+//                              -*- Mode: C++ -*-
+// ModelArena.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Tue Apr 12 10:44:03 2011
+
+
+#ifndef _annotate_ModelArena_h_
+#define _annotate_ModelArena_h_
+
+#include <cstddef>
+
+
+
+namespace annotate
+{
+
+  struct ArenaChunk;
+
+
+  /**
+   * @short Bump allocator for the objects of one model.
+   *
+   * When mcannotate is built with ARENA_ALLOCATOR, the global operator new
+   * takes its memory from the arena active in the calling thread, if any,
+   * instead of malloc.  The residues and atoms built by the factory
+   * methods and the relations computed by the model then live in large
+   * chunks.  Every chunk counts its live objects: a delete only decrements
+   * that count, and a chunk goes back to a shared pool when the count falls
+   * to zero and the arena moved on, so tearing a model down is a bulk
+   * release.  Only the thread that activated the arena allocates from it;
+   * the objects may be deleted from any thread.
+   *
+   * The build option has costs even without an active arena: every block
+   * carries a 16 bytes header and every allocation a thread-local lookup.
+   * While active, the arena takes every allocation of its thread, not only
+   * the model objects, and the memory of a deleted object is not reused:
+   * a chunk is only reclaimed as a whole, so the footprint of a model is
+   * everything it allocated, and an object outliving the model (a label
+   * table entry, an output buffer) pins its chunk.
+   */
+  class ModelArena
+  {
+    /**
+     * The chunk being filled, null before the first allocation.
+     */
+    ArenaChunk *chunk;
+
+    /**
+     * The number of bytes handed out.
+     */
+    size_t allocated;
+
+    /**
+     * The number of chunks taken.
+     */
+    unsigned int nbChunks;
+
+    /**
+     * The resident set size before the first chunk, in kilobytes.
+     */
+    long startRss;
+
+    /**
+     * The largest resident set size seen while taking the chunks, in
+     * kilobytes.
+     */
+    long peakRss;
+
+  public:
+
+    /**
+     * The size of the chunks, larger objects get a chunk of their own.
+     */
+    static const size_t CHUNK_SIZE = 1 << 20;
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    ModelArena ();
+
+    /**
+     * Destroys the object.  The chunks still holding live objects are
+     * released when their last object is deleted.
+     */
+    ~ModelArena ();
+
+  private:
+
+    ModelArena (const ModelArena &right);
+
+    ModelArena& operator= (const ModelArena &right);
+
+  public:
+
+    // ACCESS ---------------------------------------------------------------
+
+    /**
+     * Gets the number of bytes allocated from the arena, its high-water mark
+     * since the memory of deleted objects is not reused.
+     */
+    size_t getAllocated () const { return allocated; }
+
+    unsigned int getNbChunks () const { return nbChunks; }
+
+    /**
+     * Gets the growth of the resident set size of the process while the
+     * arena took its chunks, in kilobytes.  The size is sampled when a
+     * chunk is taken, so the pages touched in the last chunk are not
+     * counted.
+     */
+    long getRssGrowth () const { return peakRss - startRss; }
+
+    /**
+     * Gets the arena active in the calling thread, null if none.
+     */
+    static ModelArena* getCurrent ();
+
+    /**
+     * Tells if the global operator new uses the arenas (ARENA_ALLOCATOR).
+     */
+    static bool isEnabled ();
+
+    /**
+     * Gets the current resident set size of the process, in kilobytes, 0
+     * if unknown.
+     */
+    static long getRss ();
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Allocates memory from the arena.
+     * @param n the number of bytes.
+     * @return the memory, 16 bytes aligned.
+     */
+    void* allocate (size_t n);
+
+    /**
+     * Releases an object allocated from an arena.
+     * @param p the object memory.
+     * @return false if p was not allocated from an arena.
+     */
+    static bool release (void *p);
+
+  private:
+
+    /**
+     * Gives up the current chunk.
+     */
+    void retire ();
+
+    friend class ArenaScope;
+
+  };
+
+
+  /**
+   * @short Activates an arena in the calling thread for its lifetime.
+   */
+  class ArenaScope
+  {
+    ModelArena *previous;
+
+  public:
+
+    /**
+     * Activates the arena.
+     * @param arena the arena, null to allocate from malloc.
+     */
+    ArenaScope (ModelArena *arena);
+
+    /**
+     * Restores the previously active arena.
+     */
+    ~ArenaScope ();
+
+  private:
+
+    ArenaScope (const ArenaScope &right);
+
+    ArenaScope& operator= (const ArenaScope &right);
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,63 @@
+//                              -*- Mode: C++ -*-
+// Multiplet.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Thu Apr 21 10:05:39 2011
+
+
+#ifndef _annotate_Multiplet_h_
+#define _annotate_Multiplet_h_
+
+#include <vector>
+
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Residues joined by base pairs: a base triple, quadruple...
+   *
+   * A multiplet is a connected set of at least three residues of the
+   * pairing graph.  It holds the vertex labels of its residues and the
+   * relation table rows of its base pairs, both in order.
+   */
+  class Multiplet
+  {
+    vector< unsigned int > residues;
+
+    vector< unsigned int > rows;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    Multiplet () { }
+
+    ~Multiplet () { }
+
+    // ACCESS ---------------------------------------------------------------
+
+    /**
+     * Gets the vertex labels of the residues.
+     */
+    const vector< unsigned int >& getResidues () const { return residues; }
+
+    /**
+     * Gets the relation table rows of the base pairs.
+     */
+    const vector< unsigned int >& getRows () const { return rows; }
+
+    // METHODS --------------------------------------------------------------
+
+    void addResidue (unsigned int l) { residues.push_back (l); }
+
+    void addRow (unsigned int row) { rows.push_back (row); }
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+//                              -*- Mode: C++ -*-
+// NeighborList.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Apr  4 15:26:09 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include "mccore/Residue.h"
+
+#include "NeighborList.h"
+#include "ResidueGrid.h"
+
+
+
+namespace annotate
+{
+
+  NeighborList::NeighborList (float cut, float sk, float size)
+    : cutoff (cut),
+      skin (sk),
+      cellSize (size),
+      nbFrames (0),
+      nbRebuilds (0)
+  { }
+
+
+  const vector< pair< unsigned int, unsigned int > >&
+  NeighborList::update (const GraphModel &model, const SphereTable &spheres)
+  {
+    ++nbFrames;
+    if (0 == nbRebuilds || isStale (model))
+      {
+	ResidueGrid grid (cutoff + skin, cellSize);
+
+	pairs.clear ();
+	grid.build (spheres);
+	grid.candidates (pairs);
+	snapshot (model);
+	++nbRebuilds;
+      }
+    return pairs;
+  }
+
+
+  bool
+  NeighborList::isStale (const GraphModel &model) const
+  {
+    GraphModel::const_iterator resIt;
+    vector< float >::const_iterator refIt = reference.begin ();
+    vector< unsigned int >::const_iterator countIt = atomCounts.begin ();
+    float limit = skin * skin / 4;
+
+    if (model.size () != atomCounts.size ())
+      {
+	return true;
+      }
+    for (resIt = model.begin (); model.end () != resIt; ++resIt, ++countIt)
+      {
+	Residue::const_iterator aIt;
+
+	if (resIt->size () != *countIt)
+	  {
+	    return true;
+	  }
+	for (aIt = resIt->begin (); resIt->end () != aIt; ++aIt, refIt += 3)
+	  {
+	    float dx = aIt->getX () - refIt[0];
+	    float dy = aIt->getY () - refIt[1];
+	    float dz = aIt->getZ () - refIt[2];
+
+	    if (dx * dx + dy * dy + dz * dz > limit)
+	      {
+		return true;
+	      }
+	  }
+      }
+    return false;
+  }
+
+
+  void
+  NeighborList::snapshot (const GraphModel &model)
+  {
+    GraphModel::const_iterator resIt;
+
+    reference.clear ();
+    atomCounts.clear ();
+    for (resIt = model.begin (); model.end () != resIt; ++resIt)
+      {
+	Residue::const_iterator aIt;
+
+	atomCounts.push_back (resIt->size ());
+	for (aIt = resIt->begin (); resIt->end () != aIt; ++aIt)
+	  {
+	    reference.push_back (aIt->getX ());
+	    reference.push_back (aIt->getY ());
+	    reference.push_back (aIt->getZ ());
+	  }
+      }
+  }
+
+}
@@ -0,0 +1,127 @@
+//                              -*- Mode: C++ -*-
+// NeighborList.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Apr  4 15:26:09 2011
+
+
+#ifndef _annotate_NeighborList_h_
+#define _annotate_NeighborList_h_
+
+#include <utility>
+#include <vector>
+
+#include "mccore/GraphModel.h"
+
+#include "SphereTable.h"
+
+using namespace mccore;
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Verlet neighbor list of residue pairs reused across trajectory
+   * frames.
+   *
+   * The list holds the residue pairs whose bounding spheres were within the
+   * contact cutoff plus a skin distance when it was built.  As long as no
+   * atom moved by more than half the skin since then, every pair of
+   * residues with atoms within the cutoff is still in the list, so the
+   * frame can be annotated from the list alone.  The list is rebuilt when
+   * an atom moved further or when the residue topology changed.
+   */
+  class NeighborList
+  {
+    /**
+     * The contact cutoff.
+     */
+    float cutoff;
+
+    /**
+     * The skin distance added to the cutoff.
+     */
+    float skin;
+
+    /**
+     * The grid cell size used to build the list, 0 for automatic.
+     */
+    float cellSize;
+
+    /**
+     * The atom coordinates (x, y, z) when the list was built.
+     */
+    vector< float > reference;
+
+    /**
+     * The number of atoms of each residue when the list was built.
+     */
+    vector< unsigned int > atomCounts;
+
+    /**
+     * The residue label pairs (i, j), i < j.
+     */
+    vector< pair< unsigned int, unsigned int > > pairs;
+
+    /**
+     * The number of frames given to update.
+     */
+    unsigned int nbFrames;
+
+    /**
+     * The number of list builds.
+     */
+    unsigned int nbRebuilds;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    /**
+     * Initializes the object.
+     * @param cut the contact cutoff.
+     * @param sk the skin distance.
+     * @param size the grid cell size, 0 for automatic.
+     */
+    NeighborList (float cut, float sk, float size = 0);
+
+    ~NeighborList () { }
+
+    // ACCESS ---------------------------------------------------------------
+
+    unsigned int getNbFrames () const { return nbFrames; }
+
+    unsigned int getNbRebuilds () const { return nbRebuilds; }
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Gets the candidate pairs of a new frame, rebuilding the list if
+     * needed.
+     * @param model the frame.
+     * @param spheres the frame's residue bounding spheres, in label order.
+     * @return the candidate residue label pairs.
+     */
+    const vector< pair< unsigned int, unsigned int > >&
+    update (const GraphModel &model, const SphereTable &spheres);
+
+  private:
+
+    /**
+     * Tells if the list must be rebuilt for the frame.
+     */
+    bool isStale (const GraphModel &model) const;
+
+    /**
+     * Records the frame's atom coordinates as the reference.
+     */
+    void snapshot (const GraphModel &model);
+
+  };
+
+}
+
+#endif
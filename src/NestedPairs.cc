@@ -0,0 +1,151 @@
+//                              -*- Mode: C++ -*-
+// NestedPairs.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Wed Apr 20 11:32:48 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <algorithm>
+
+#include "NestedPairs.h"
+
+
+
+namespace annotate
+{
+
+  /**
+   * Orders the pairs by end position.
+   */
+  struct ArcEndLess
+  {
+    bool operator() (const NestedPairs::Arc &left, const NestedPairs::Arc &right) const
+    {
+      return (left.second < right.second
+	      || (left.second == right.second && left.first < right.first));
+    }
+  };
+
+
+  NestedPairs::NestedPairs (unsigned int n)
+  {
+    reset (n);
+  }
+
+
+  void
+  NestedPairs::reset (unsigned int n)
+  {
+    ends.assign (n + 1, 0);
+    best.assign (n + 1, 0);
+  }
+
+
+  void
+  NestedPairs::split (const vector< Arc > &pairs, vector< Arc > &nested, vector< Arc > &rest)
+  {
+    vector< pair< unsigned int, unsigned int > > bySpan;
+    vector< pair< unsigned int, unsigned int > > intervals;
+    vector< bool > chosen;
+    unsigned int i;
+
+    arcs = pairs;
+    std::sort (arcs.begin (), arcs.end (), ArcEndLess ());
+    std::fill (ends.begin (), ends.end (), 0);
+    for (i = 0; i < arcs.size (); ++i)
+      {
+	++ends[arcs[i].second + 1];
+      }
+    for (i = 1; i < ends.size (); ++i)
+      {
+	ends[i] += ends[i - 1];
+      }
+
+    // The pairs inside a pair are shorter, so they are solved before it.
+    inner.resize (arcs.size ());
+    for (i = 0; i < arcs.size (); ++i)
+      {
+	bySpan.push_back (make_pair (arcs[i].second - arcs[i].first, i));
+      }
+    std::sort (bySpan.begin (), bySpan.end ());
+    for (i = 0; i < bySpan.size (); ++i)
+      {
+	const Arc &a = arcs[bySpan[i].second];
+
+	fill (a.first + 1, a.second - 1);
+	inner[bySpan[i].second] = best[a.second] + 1;
+      }
+
+    // Walks back the rows of the whole range, then of the inside of every
+    // pair taken.
+    chosen.resize (arcs.size (), false);
+    if (! arcs.empty ())
+      {
+	intervals.push_back (make_pair (0, arcs.back ().second));
+      }
+    while (! intervals.empty ())
+      {
+	unsigned int lo = intervals.back ().first;
+	unsigned int p = intervals.back ().second + 1;
+
+	intervals.pop_back ();
+	fill (lo, p - 1);
+	while (p > lo)
+	  {
+	    unsigned int b;
+
+	    if (best[p] == best[p - 1])
+	      {
+		--p;
+		continue;
+	      }
+	    for (b = ends[p - 1]; b < ends[p]; ++b)
+	      {
+		if (arcs[b].first >= lo && best[p] == best[arcs[b].first] + inner[b])
+		  {
+		    break;
+		  }
+	      }
+	    chosen[b] = true;
+	    if (arcs[b].first + 1 < arcs[b].second)
+	      {
+		intervals.push_back (make_pair (arcs[b].first + 1, arcs[b].second - 1));
+	      }
+	    p = arcs[b].first;
+	  }
+      }
+
+    nested.clear ();
+    rest.clear ();
+    for (i = 0; i < arcs.size (); ++i)
+      {
+	(chosen[i] ? nested : rest).push_back (arcs[i]);
+      }
+  }
+
+
+  void
+  NestedPairs::fill (unsigned int lo, unsigned int hi)
+  {
+    unsigned int x;
+
+    best[lo] = 0;
+    for (x = lo; x <= hi; ++x)
+      {
+	unsigned int b;
+
+	best[x + 1] = best[x];
+	for (b = ends[x]; b < ends[x + 1]; ++b)
+	  {
+	    if (arcs[b].first >= lo)
+	      {
+		best[x + 1] = std::max (best[x + 1], best[arcs[b].first] + inner[b]);
+	      }
+	  }
+      }
+  }
+
+}
@@ -0,0 +1,102 @@
+//                              -*- Mode: C++ -*-
+// NestedPairs.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Wed Apr 20 11:32:48 2011
+
+
+#ifndef _annotate_NestedPairs_h_
+#define _annotate_NestedPairs_h_
+
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Largest nested subset of a set of pairs.
+   *
+   * The pairs (i, j), i < j, join positions 0..n-1.  Two pairs are nested
+   * when they neither cross nor share a position.  The largest nested
+   * subset is found by dynamic programming over the intervals: the best
+   * count inside each pair is computed from the shorter pairs, each one
+   * with a linear pass over the positions it spans, so the time is the sum
+   * of the pair spans and the memory is linear.
+   */
+  class NestedPairs
+  {
+  public:
+
+    typedef pair< unsigned int, unsigned int > Arc;
+
+  private:
+
+    /**
+     * The pairs by end position.
+     */
+    vector< Arc > arcs;
+
+    /**
+     * The pairs ending at position x are arcs[ends[x]] to arcs[ends[x + 1]].
+     */
+    vector< unsigned int > ends;
+
+    /**
+     * The size of the largest nested subset inside each pair, itself
+     * included.
+     */
+    vector< unsigned int > inner;
+
+    /**
+     * The work row: best[x + 1] is the size of the largest nested subset
+     * from the start of the interval to position x.
+     */
+    vector< unsigned int > best;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    /**
+     * Initializes the object.
+     * @param n the number of positions.
+     */
+    NestedPairs (unsigned int n = 0);
+
+    ~NestedPairs () { }
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Sizes the object for a number of positions.
+     * @param n the number of positions.
+     */
+    void reset (unsigned int n);
+
+    /**
+     * Splits a set of pairs into a largest nested subset and the rest.
+     * @param pairs the distinct pairs (i, j), i < j.
+     * @param nested the nested pairs, by end position (output).
+     * @param rest the other pairs, by end position (output).
+     */
+    void split (const vector< Arc > &pairs, vector< Arc > &nested, vector< Arc > &rest);
+
+  private:
+
+    /**
+     * Fills best for an interval, from the pairs inside it.
+     * @param lo the first position.
+     * @param hi the last position, lo - 1 for an empty interval.
+     */
+    void fill (unsigned int lo, unsigned int hi);
+
+  };
+
+}
+
+#endif
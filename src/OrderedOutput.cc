@@ -0,0 +1,66 @@
+//                              -*- Mode: C++ -*-
+// OrderedOutput.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Mar 14 11:02:47 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include "mccore/Messagestream.h"
+
+#include "OrderedOutput.h"
+
+using namespace mccore;
+
+
+
+namespace annotate
+{
+
+  OrderedOutput::OrderedOutput (unsigned int first)
+    : nextIndex (first),
+      outStream (0),
+      errStream (0)
+  {
+    pthread_mutex_init (&mutex, 0);
+  }
+
+
+  OrderedOutput::OrderedOutput (ostream &out, ostream &err, unsigned int first)
+    : nextIndex (first),
+      outStream (&out),
+      errStream (&err)
+  {
+    pthread_mutex_init (&mutex, 0);
+  }
+
+
+  OrderedOutput::~OrderedOutput ()
+  {
+    pthread_mutex_destroy (&mutex);
+  }
+
+
+  void
+  OrderedOutput::post (unsigned int index, const string &out, const string &err)
+  {
+    map< unsigned int, pair< string, string > >::iterator it;
+
+    pthread_mutex_lock (&mutex);
+    pending.insert (make_pair (index, make_pair (out, err)));
+    while (pending.end () != (it = pending.find (nextIndex)))
+      {
+	if (! it->second.second.empty ())
+	  {
+	    (0 == errStream ? gErr (0) : *errStream) << it->second.second << flush;
+	  }
+	(0 == outStream ? gOut (0) : *outStream) << it->second.first << flush;
+	pending.erase (it);
+	++nextIndex;
+      }
+    pthread_mutex_unlock (&mutex);
+  }
+
+}
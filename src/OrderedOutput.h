@@ -0,0 +1,106 @@
+//                              -*- Mode: C++ -*-
+// OrderedOutput.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Mar 14 11:02:47 2011
+
+
+#ifndef _annotate_OrderedOutput_h_
+#define _annotate_OrderedOutput_h_
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+
+#include <pthread.h>
+
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Serializes the outputs of concurrent jobs in job order.
+   *
+   * Each job posts its complete standard and error output text once.  The
+   * texts are written to the target streams (gOut and gErr by default) as
+   * soon as every job with a lower index has been written, so the result is
+   * identical to a serial run.  Only this object writes to the target
+   * streams, under its mutex.
+   */
+  class OrderedOutput
+  {
+    /**
+     * Protects the pending texts and the message streams.
+     */
+    pthread_mutex_t mutex;
+
+    /**
+     * The index of the next job to write.
+     */
+    unsigned int nextIndex;
+
+    /**
+     * The standard and error texts posted ahead of their turn.
+     */
+    map< unsigned int, pair< string, string > > pending;
+
+    /**
+     * The target standard stream, null for gOut.
+     */
+    ostream *outStream;
+
+    /**
+     * The target error stream, null for gErr.
+     */
+    ostream *errStream;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    /**
+     * Initializes the object.
+     * @param first the index of the first job.
+     */
+    OrderedOutput (unsigned int first = 0);
+
+    /**
+     * Initializes the object with explicit target streams.
+     * @param out the standard target stream.
+     * @param err the error target stream.
+     * @param first the index of the first job.
+     */
+    OrderedOutput (ostream &out, ostream &err, unsigned int first = 0);
+
+    /**
+     * Destroys the object.
+     */
+    ~OrderedOutput ();
+
+  private:
+
+    OrderedOutput (const OrderedOutput &right);
+
+    OrderedOutput& operator= (const OrderedOutput &right);
+
+  public:
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Posts the output of a job.  The texts are copied.
+     * @param index the job index.
+     * @param out the standard output text.
+     * @param err the error output text.
+     */
+    void post (unsigned int index, const string &out, const string &err);
+
+  };
+
+}
+
+#endif
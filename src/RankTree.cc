@@ -0,0 +1,52 @@
+//                              -*- Mode: C++ -*-
+// RankTree.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Tue Apr 19 15:07:33 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include "RankTree.h"
+
+
+
+namespace annotate
+{
+
+  RankTree::RankTree (unsigned int n)
+  {
+    reset (n);
+  }
+
+
+  void
+  RankTree::reset (unsigned int n)
+  {
+    counts.assign (n + 1, 0);
+    for (top = 1; top <= n / 2; top <<= 1)
+      ;
+  }
+
+
+  unsigned int
+  RankTree::select (unsigned int k) const
+  {
+    unsigned int pos = 0;
+    unsigned int step;
+
+    // Descends the implicit tree, pos being the largest index whose prefix
+    // holds at most k members.
+    for (step = top; 0 != step; step >>= 1)
+      {
+	if (pos + step < counts.size () && counts[pos + step] <= k)
+	  {
+	    pos += step;
+	    k -= counts[pos];
+	  }
+      }
+    return pos;
+  }
+
+}
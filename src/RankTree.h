@@ -0,0 +1,101 @@
+//                              -*- Mode: C++ -*-
+// RankTree.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Tue Apr 19 15:07:33 2011
+
+
+#ifndef _annotate_RankTree_h_
+#define _annotate_RankTree_h_
+
+#include <vector>
+
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Set of integer ranks in a Fenwick tree.
+   *
+   * Holds a subset of the ranks 0..n-1.  Inserting a rank, counting the
+   * ranks below a bound and selecting the k-th smallest rank take
+   * O(log n) time, so the members of a rank range are listed in O(log n)
+   * time each.
+   */
+  class RankTree
+  {
+    /**
+     * The Fenwick tree, counts[i] covers the ranks i - (i & -i) to i - 1.
+     */
+    vector< unsigned int > counts;
+
+    /**
+     * The highest power of 2 not above the number of ranks.
+     */
+    unsigned int top;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    /**
+     * Initializes the object.
+     * @param n the number of ranks.
+     */
+    RankTree (unsigned int n = 0);
+
+    ~RankTree () { }
+
+    // ACCESS ---------------------------------------------------------------
+
+    /**
+     * Counts the members below a rank.
+     * @param rank the bound, at most the number of ranks.
+     * @return the number of members smaller than rank.
+     */
+    unsigned int countBelow (unsigned int rank) const
+    {
+      unsigned int n = 0;
+
+      for (; 0 != rank; rank &= rank - 1)
+	{
+	  n += counts[rank];
+	}
+      return n;
+    }
+
+    /**
+     * Selects a member by order.
+     * @param k the order, less than the number of members.
+     * @return the k-th smallest member, from 0.
+     */
+    unsigned int select (unsigned int k) const;
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Empties the set and sizes it for a number of ranks.
+     * @param n the number of ranks.
+     */
+    void reset (unsigned int n);
+
+    /**
+     * Inserts a rank, not already a member.
+     * @param rank the rank.
+     */
+    void insert (unsigned int rank)
+    {
+      for (++rank; rank < counts.size (); rank += rank & (0 - rank))
+	{
+	  ++counts[rank];
+	}
+    }
+
+  };
+
+}
+
+#endif
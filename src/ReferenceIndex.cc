@@ -0,0 +1,269 @@
+//                              -*- Mode: C++ -*-
+// ReferenceIndex.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Fri Apr 22 13:48:20 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "mccore/PropertyType.h"
+
+#include "AnnotateModel.h"
+#include "LabelTable.h"
+#include "ReferenceIndex.h"
+#include "TextWriter.h"
+
+
+
+namespace annotate
+{
+
+  const char *ReferenceIndex::CLASS_NAMES[ReferenceIndex::NB_CLASSES] =
+    { "all", "wc", "nwc", "stack" };
+
+  const unsigned int ReferenceIndex::NONE;
+
+
+  double
+  ReferenceIndex::Scores::getPpv (unsigned int c) const
+  {
+    return 0 == tp[c] + fp[c] ? 0 : (double) tp[c] / (tp[c] + fp[c]);
+  }
+
+
+  double
+  ReferenceIndex::Scores::getSty (unsigned int c) const
+  {
+    return 0 == tp[c] + fn[c] ? 0 : (double) tp[c] / (tp[c] + fn[c]);
+  }
+
+
+  double
+  ReferenceIndex::Scores::getInf (unsigned int c) const
+  {
+    return sqrt (getPpv (c) * getSty (c));
+  }
+
+
+  ReferenceIndex::ReferenceIndex ()
+  { }
+
+
+  unsigned int
+  ReferenceIndex::getNbInteractions (unsigned int c) const
+  {
+    unsigned int n = 0;
+    unsigned int k;
+
+    if (ALL != c)
+      {
+	return keys[c].size ();
+      }
+    for (k = ALL + 1; k < NB_CLASSES; ++k)
+      {
+	n += keys[k].size ();
+      }
+    return n;
+  }
+
+
+  void
+  ReferenceIndex::build (const AnnotateModel &am)
+  {
+    AnnotateModel::const_iterator i;
+    vector< unsigned int > ranks;
+    unsigned int unmatched[NB_CLASSES];
+
+    residues.clear ();
+    for (i = am.begin (); am.end () != i; ++i)
+      {
+	residues.push_back (i->getResId ());
+      }
+    std::sort (residues.begin (), residues.end ());
+    residues.erase (std::unique (residues.begin (), residues.end ()), residues.end ());
+    getRanks (am, ranks);
+    getKeys (am, ranks, keys, unmatched);
+  }
+
+
+  void
+  ReferenceIndex::compare (const AnnotateModel &am, Scores &scores) const
+  {
+    vector< unsigned int > ranks;
+    vector< uint64_t > decoy[NB_CLASSES];
+    unsigned int unmatched[NB_CLASSES];
+    unsigned int c;
+
+    getRanks (am, ranks);
+    getKeys (am, ranks, decoy, unmatched);
+    scores.tp[ALL] = scores.fp[ALL] = scores.fn[ALL] = 0;
+    for (c = ALL + 1; c < NB_CLASSES; ++c)
+      {
+	vector< uint64_t >::const_iterator r = keys[c].begin ();
+	vector< uint64_t >::const_iterator d = decoy[c].begin ();
+
+	scores.tp[c] = 0;
+	scores.fp[c] = unmatched[c];
+	scores.fn[c] = 0;
+	while (keys[c].end () != r && decoy[c].end () != d)
+	  {
+	    if (*r < *d)
+	      {
+		++scores.fn[c];
+		++r;
+	      }
+	    else if (*d < *r)
+	      {
+		++scores.fp[c];
+		++d;
+	      }
+	    else
+	      {
+		++scores.tp[c];
+		++r;
+		++d;
+	      }
+	  }
+	scores.fn[c] += keys[c].end () - r;
+	scores.fp[c] += decoy[c].end () - d;
+	scores.tp[ALL] += scores.tp[c];
+	scores.fp[ALL] += scores.fp[c];
+	scores.fn[ALL] += scores.fn[c];
+      }
+  }
+
+
+  void
+  ReferenceIndex::getRanks (const AnnotateModel &am, vector< unsigned int > &ranks) const
+  {
+    AnnotateModel::const_iterator i;
+
+    ranks.clear ();
+    ranks.reserve (am.size ());
+    for (i = am.begin (); am.end () != i; ++i)
+      {
+	vector< ResId >::const_iterator it;
+
+	it = std::lower_bound (residues.begin (), residues.end (), i->getResId ());
+	ranks.push_back (residues.end () != it && *it == i->getResId ()
+			 ? (unsigned int) (it - residues.begin ())
+			 : NONE);
+      }
+  }
+
+
+  void
+  ReferenceIndex::getKeys (const AnnotateModel &am, const vector< unsigned int > &ranks,
+			   vector< uint64_t > *byClass, unsigned int *unmatched) const
+  {
+    const vector< BasePair > &basepairs = am.getBasePairs ();
+    const vector< BaseStack > &stacks = am.getStacks ();
+    // Taken once the labels of the model have their ids.
+    LabelSet wcMask = (LabelTable::getMask (PropertyType::parseType ("XIX"))
+		       | LabelTable::getMask (PropertyType::parseType ("XX"))
+		       | LabelTable::getMask (PropertyType::parseType ("XXVIII")));
+    unsigned int i;
+    unsigned int c;
+
+    for (c = 0; c < NB_CLASSES; ++c)
+      {
+	byClass[c].clear ();
+	unmatched[c] = 0;
+      }
+    // A pair of ranks is a key whatever the residue order.
+    for (i = 0; i < basepairs.size () + stacks.size (); ++i)
+      {
+	unsigned int a;
+	unsigned int b;
+
+	if (i < basepairs.size ())
+	  {
+	    a = ranks[basepairs[i].first];
+	    b = ranks[basepairs[i].second];
+	    c = basepairs[i].labels.intersects (wcMask) ? WC : NWC;
+	  }
+	else
+	  {
+	    a = ranks[stacks[i - basepairs.size ()].first];
+	    b = ranks[stacks[i - basepairs.size ()].second];
+	    c = STACK;
+	  }
+	if (NONE == a || NONE == b)
+	  {
+	    ++unmatched[c];
+	  }
+	else
+	  {
+	    byClass[c].push_back ((uint64_t) std::min (a, b) << 32 | std::max (a, b));
+	  }
+      }
+    // The table rows are sorted by residue rank, so the keys are sorted
+    // already when the model lists its residues in the reference order.
+    // They are checked in one pass and only sorted otherwise.
+    for (c = ALL + 1; c < NB_CLASSES; ++c)
+      {
+	vector< uint64_t > &k = byClass[c];
+
+	for (i = 1; i < k.size () && k[i - 1] <= k[i]; ++i)
+	  ;
+	if (i < k.size ())
+	  {
+	    std::sort (k.begin (), k.end ());
+	  }
+	k.erase (std::unique (k.begin (), k.end ()), k.end ());
+      }
+  }
+
+
+  ostream&
+  ReferenceIndex::output (ostream &os, const string &file, unsigned int model,
+			  const Scores &scores)
+  {
+    ostringstream oss;
+    unsigned int c;
+
+    oss << file << ' ' << model << setiosflags (ios::fixed) << setprecision (3);
+    for (c = 0; c < NB_CLASSES; ++c)
+      {
+	oss << ' ' << CLASS_NAMES[c]
+	    << ' ' << scores.getInf (c) << ' ' << scores.getPpv (c) << ' ' << scores.getSty (c)
+	    << ' ' << scores.tp[c] << ' ' << scores.fp[c] << ' ' << scores.fn[c];
+      }
+    oss << endl;
+    return os << oss.str ();
+  }
+
+
+  ostream&
+  ReferenceIndex::outputJsonl (ostream &os, const string &file, unsigned int model,
+			       const Scores &scores)
+  {
+    ostringstream oss;
+    unsigned int c;
+
+    {
+      TextWriter tw (oss);
+
+      tw.put ("{\"file\":").putQuoted (file).put (",\"model\":").put ((unsigned long) model)
+	.put (",\"type\":\"scores\"");
+    }
+    oss << setiosflags (ios::fixed) << setprecision (6);
+    for (c = 0; c < NB_CLASSES; ++c)
+      {
+	oss << ",\"" << CLASS_NAMES[c] << "\":{\"inf\":" << scores.getInf (c)
+	    << ",\"ppv\":" << scores.getPpv (c) << ",\"sty\":" << scores.getSty (c)
+	    << ",\"tp\":" << scores.tp[c] << ",\"fp\":" << scores.fp[c]
+	    << ",\"fn\":" << scores.fn[c] << '}';
+      }
+    oss << '}' << endl;
+    return os << oss.str ();
+  }
+
+}
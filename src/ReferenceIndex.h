@@ -0,0 +1,186 @@
+//                              -*- Mode: C++ -*-
+// ReferenceIndex.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Fri Apr 22 13:48:20 2011
+
+
+#ifndef _annotate_ReferenceIndex_h_
+#define _annotate_ReferenceIndex_h_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+#include "mccore/ResId.h"
+
+using namespace mccore;
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  class AnnotateModel;
+
+
+  /**
+   * @short Interactions of a reference model, for scoring decoys.
+   *
+   * The base pairs and stacks of the annotated reference are kept as
+   * sorted keys, a pair of reference residue ranks, by interaction class:
+   * canonical pairs (Saenger XIX, XX and XXVIII), other pairs and stacks.
+   * The interactions of a decoy are keyed the same way, the residues
+   * matched by residue id, and merged with the reference keys in linear
+   * time.  The index is read only once built, so decoys may be compared
+   * concurrently.
+   */
+  class ReferenceIndex
+  {
+  public:
+
+    /**
+     * The interaction classes, ALL being the union of the others.
+     */
+    enum { ALL = 0, WC, NWC, STACK, NB_CLASSES };
+
+    /**
+     * The class names.
+     */
+    static const char *CLASS_NAMES[NB_CLASSES];
+
+    /**
+     * @short Comparison counts of a decoy, by class.
+     */
+    struct Scores
+    {
+      unsigned int tp[NB_CLASSES];
+      unsigned int fp[NB_CLASSES];
+      unsigned int fn[NB_CLASSES];
+
+      /**
+       * Gets the precision, TP / (TP + FP), 0 without decoy interaction.
+       */
+      double getPpv (unsigned int c) const;
+
+      /**
+       * Gets the sensitivity, TP / (TP + FN), 0 without reference
+       * interaction.
+       */
+      double getSty (unsigned int c) const;
+
+      /**
+       * Gets the interaction network fidelity, sqrt (PPV * STY).
+       */
+      double getInf (unsigned int c) const;
+    };
+
+  private:
+
+    /**
+     * The rank of a residue not in the reference.
+     */
+    static const unsigned int NONE = 0xffffffff;
+
+    /**
+     * The sorted residue ids of the reference, their rank in the keys.
+     */
+    vector< ResId > residues;
+
+    /**
+     * The sorted interaction keys of each class but ALL.
+     */
+    vector< uint64_t > keys[NB_CLASSES];
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    ReferenceIndex ();
+
+    ~ReferenceIndex () { }
+
+  private:
+
+    ReferenceIndex (const ReferenceIndex &right);
+
+    ReferenceIndex& operator= (const ReferenceIndex &right);
+
+  public:
+
+    // ACCESS ---------------------------------------------------------------
+
+    /**
+     * Gets the number of reference interactions of a class.
+     */
+    unsigned int getNbInteractions (unsigned int c) const;
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Indexes the interactions of the reference.
+     * @param am the annotated reference model.
+     */
+    void build (const AnnotateModel &am);
+
+    /**
+     * Compares a decoy with the reference.
+     * @param am the annotated decoy model.
+     * @param scores the counts (output).
+     */
+    void compare (const AnnotateModel &am, Scores &scores) const;
+
+    // I/O  -----------------------------------------------------------------
+
+    /**
+     * Writes the scores of a decoy on one line: the file, the model, then
+     * for each class its name, INF, PPV, STY, TP, FP and FN.
+     * @param os the output stream.
+     * @param file the decoy file name.
+     * @param model the model number.
+     * @param scores the counts.
+     * @return the used output stream.
+     */
+    static ostream& output (ostream &os, const string &file, unsigned int model,
+			    const Scores &scores);
+
+    /**
+     * Writes the scores of a decoy as one JSON record.
+     * @param os the output stream.
+     * @param file the decoy file name.
+     * @param model the model number.
+     * @param scores the counts.
+     * @return the used output stream.
+     */
+    static ostream& outputJsonl (ostream &os, const string &file, unsigned int model,
+				 const Scores &scores);
+
+  private:
+
+    /**
+     * Gets the reference rank of each residue of a model.
+     * @param am the model.
+     * @param ranks the ranks by vertex label, NONE for the residues not in
+     * the reference (output).
+     */
+    void getRanks (const AnnotateModel &am, vector< unsigned int > &ranks) const;
+
+    /**
+     * Fills the sorted keys of the interactions of a model.
+     * @param am the model.
+     * @param ranks the ranks of the model residues.
+     * @param byClass the keys of each class (output).
+     * @param unmatched the number of interactions of each class with a
+     * residue not in the reference (output).
+     */
+    void getKeys (const AnnotateModel &am, const vector< unsigned int > &ranks,
+		  vector< uint64_t > *byClass, unsigned int *unmatched) const;
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,97 @@
+//                              -*- Mode: C++ -*-
+// RelationTable.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Fri Apr  8 10:07:45 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <algorithm>
+
+#include "RelationTable.h"
+
+
+
+namespace annotate
+{
+
+  void
+  RelationTable::clear ()
+  {
+    kinds.clear ();
+    refs.clear ();
+    ress.clear ();
+    keys.clear ();
+    labels.clear ();
+    relations.clear ();
+    faceStarts.clear ();
+    nbFaces.clear ();
+    faces.clear ();
+  }
+
+
+  void
+  RelationTable::reserve (unsigned int n)
+  {
+    kinds.reserve (n);
+    refs.reserve (n);
+    ress.reserve (n);
+    keys.reserve (n);
+    labels.reserve (n);
+    relations.reserve (n);
+    faceStarts.reserve (n);
+    nbFaces.reserve (n);
+  }
+
+
+  void
+  RelationTable::sort ()
+  {
+    vector< unsigned int > order (size ());
+    vector< unsigned int > tmp (size ());
+    unsigned int count[256];
+    uint64_t all;
+    unsigned int shift;
+    unsigned int i;
+
+    for (i = 0, all = 0; i < size (); ++i)
+      {
+	order[i] = i;
+	all |= keys[i];
+      }
+    // The bytes that are null in every key need no pass.
+    for (shift = 0; shift < 64 && 0 != (all >> shift); shift += 8)
+      {
+	unsigned int sum;
+
+	fill (count, count + 256, 0);
+	for (i = 0; i < size (); ++i)
+	  {
+	    ++count[(keys[order[i]] >> shift) & 0xff];
+	  }
+	for (i = 0, sum = 0; i < 256; ++i)
+	  {
+	    unsigned int c = count[i];
+
+	    count[i] = sum;
+	    sum += c;
+	  }
+	for (i = 0; i < size (); ++i)
+	  {
+	    tmp[count[(keys[order[i]] >> shift) & 0xff]++] = order[i];
+	  }
+	order.swap (tmp);
+      }
+    permute (kinds, order);
+    permute (refs, order);
+    permute (ress, order);
+    permute (keys, order);
+    permute (labels, order);
+    permute (relations, order);
+    permute (faceStarts, order);
+    permute (nbFaces, order);
+  }
+
+}
@@ -0,0 +1,179 @@
+//                              -*- Mode: C++ -*-
+// RelationTable.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Fri Apr  8 10:07:45 2011
+
+
+#ifndef _annotate_RelationTable_h_
+#define _annotate_RelationTable_h_
+
+#include <vector>
+
+#include <stdint.h>
+
+#include "mccore/GraphModel.h"
+#include "mccore/Relation.h"
+#include "mccore/ResId.h"
+
+#include "LabelTable.h"
+
+using namespace mccore;
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Packed structure of arrays of the annotated relations.
+   *
+   * The table holds one row per relation of interest (base pair, stack or
+   * 5' link), with its residue labels, its labels, its paired faces, a
+   * direct pointer to the relation and an integer ordering key.  The rows
+   * of a model restored from a snapshot have no relation pointer, so the
+   * dumps only read the other columns.  The key orders the rows like
+   * the (fResId, rResId) comparison of the BasePair records, so the rows
+   * are sorted with an integer radix sort and the dumps walk them in order
+   * without graph lookups.
+   */
+  class RelationTable
+  {
+  public:
+
+    /**
+     * The kinds of a row, a relation may be of several kinds.
+     */
+    enum { PAIR = 1, STACK = 2, LINK = 4 };
+
+    /**
+     * A paired face, the face of the reference then of the other residue.
+     */
+    typedef pair< const PropertyType*, const PropertyType* > Face;
+
+  private:
+
+    vector< unsigned char > kinds;
+    vector< GraphModel::label > refs;
+    vector< GraphModel::label > ress;
+    vector< uint64_t > keys;
+    vector< LabelSet > labels;
+    vector< const Relation* > relations;
+    vector< unsigned int > faceStarts;
+    vector< unsigned int > nbFaces;
+
+    /**
+     * The faces of the rows, in push_back order.
+     */
+    vector< Face > faces;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    RelationTable () { }
+
+    ~RelationTable () { }
+
+    // ACCESS ---------------------------------------------------------------
+
+    unsigned int size () const { return kinds.size (); }
+
+    bool empty () const { return kinds.empty (); }
+
+    unsigned char getKind (unsigned int i) const { return kinds[i]; }
+
+    bool is (unsigned int i, unsigned char kind) const { return 0 != (kinds[i] & kind); }
+
+    GraphModel::label getRef (unsigned int i) const { return refs[i]; }
+
+    GraphModel::label getRes (unsigned int i) const { return ress[i]; }
+
+    uint64_t getKey (unsigned int i) const { return keys[i]; }
+
+    const LabelSet& getLabels (unsigned int i) const { return labels[i]; }
+
+    /**
+     * Gets the relation of a row, null if the table was restored.
+     */
+    const Relation* getRelation (unsigned int i) const { return relations[i]; }
+
+    const Face* getFacesBegin (unsigned int i) const
+    {
+      return faces.empty () ? 0 : &faces[0] + faceStarts[i];
+    }
+
+    const Face* getFacesEnd (unsigned int i) const
+    {
+      return getFacesBegin (i) + nbFaces[i];
+    }
+
+    // METHODS --------------------------------------------------------------
+
+    void clear ();
+
+    void reserve (unsigned int n);
+
+    /**
+     * Appends a row.
+     * @param f the paired faces of the relation.
+     */
+    void push_back (unsigned char kind, GraphModel::label ref, GraphModel::label res,
+		    uint64_t key, const LabelSet &ls, const Relation *rel,
+		    const vector< Face > &f)
+    {
+      kinds.push_back (kind);
+      refs.push_back (ref);
+      ress.push_back (res);
+      keys.push_back (key);
+      labels.push_back (ls);
+      relations.push_back (rel);
+      faceStarts.push_back (faces.size ());
+      nbFaces.push_back (f.size ());
+      faces.insert (faces.end (), f.begin (), f.end ());
+    }
+
+    /**
+     * Sorts the rows by increasing key with a least significant digit
+     * radix sort.  Rows with equal keys keep their order.
+     */
+    void sort ();
+
+    /**
+     * Computes the 48 bits ordering key of a residue id: the chain, the
+     * number and the insertion code, in ResId::operator< order.
+     * @param r the residue id.
+     * @return the key.
+     */
+    static uint64_t makeKey (const ResId &r)
+    {
+      return (((uint64_t) ((unsigned char) r.getChainId () ^ 0x80) << 40)
+	      | ((uint64_t) ((uint32_t) r.getResNo () ^ 0x80000000) << 8)
+	      | (uint64_t) ((unsigned char) r.getInsertionCode () ^ 0x80));
+    }
+
+  private:
+
+    /**
+     * Reorders a column.
+     */
+    template< class T >
+    static void permute (vector< T > &column, const vector< unsigned int > &order)
+    {
+      vector< T > tmp;
+      unsigned int i;
+
+      tmp.reserve (order.size ());
+      for (i = 0; i < order.size (); ++i)
+	{
+	  tmp.push_back (column[order[i]]);
+	}
+      column.swap (tmp);
+    }
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,185 @@
+//                              -*- Mode: C++ -*-
+// ResidueGrid.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Tue Mar 22 14:05:18 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "ResidueGrid.h"
+
+
+
+namespace annotate
+{
+
+  ResidueGrid::ResidueGrid (float cut, float size)
+    : cutoff (cut),
+      cellSize (size),
+      edge (size),
+      minX (0), minY (0), minZ (0),
+      nx (0), ny (0), nz (0),
+      range (1)
+  { }
+
+
+  void
+  ResidueGrid::build (const SphereTable &spheres)
+  {
+    vector< unsigned int > cellOf;
+    float maxX, maxY, maxZ;
+    float maxRadius;
+    float size;
+    unsigned int i;
+
+    sorted.clear ();
+    cellStart.clear ();
+    items.clear ();
+    rank.clear ();
+    if (spheres.empty ())
+      {
+	return;
+      }
+
+    maxRadius = 0;
+    minX = maxX = spheres.getX (0);
+    minY = maxY = spheres.getY (0);
+    minZ = maxZ = spheres.getZ (0);
+    for (i = 0; i < spheres.size (); ++i)
+      {
+	minX = std::min (minX, spheres.getX (i));
+	minY = std::min (minY, spheres.getY (i));
+	minZ = std::min (minZ, spheres.getZ (i));
+	maxX = std::max (maxX, spheres.getX (i));
+	maxY = std::max (maxY, spheres.getY (i));
+	maxZ = std::max (maxZ, spheres.getZ (i));
+	maxRadius = std::max (maxRadius, spheres.getRadius (i));
+      }
+
+    // Two centers in contact are at most this far apart.
+    size = 2 * maxRadius + cutoff;
+    edge = 0 < cellSize ? cellSize : size;
+    while (true)
+      {
+	nx = (int) ((maxX - minX) / edge) + 1;
+	ny = (int) ((maxY - minY) / edge) + 1;
+	nz = (int) ((maxZ - minZ) / edge) + 1;
+	if ((double) nx * ny * nz <= 8.0 * spheres.size () + 4096)
+	  {
+	    break;
+	  }
+	edge *= 2;
+      }
+    range = std::max (1, (int) ceil (size / edge));
+
+    // Counting sort of the spheres by cell.
+    cellStart.resize (nx * ny * nz + 1, 0);
+    cellOf.resize (spheres.size ());
+    for (i = 0; i < spheres.size (); ++i)
+      {
+	cellOf[i] = ((cellCoord (spheres.getZ (i), minZ, nz) * ny
+		      + cellCoord (spheres.getY (i), minY, ny)) * nx
+		     + cellCoord (spheres.getX (i), minX, nx));
+	++cellStart[cellOf[i] + 1];
+      }
+    for (i = 1; i < cellStart.size (); ++i)
+      {
+	cellStart[i] += cellStart[i - 1];
+      }
+    items.resize (spheres.size ());
+    rank.resize (spheres.size ());
+    {
+      vector< unsigned int > fill (cellStart.begin (), cellStart.end () - 1);
+
+      for (i = 0; i < spheres.size (); ++i)
+	{
+	  rank[i] = fill[cellOf[i]]++;
+	  items[rank[i]] = i;
+	}
+    }
+    sorted.reserve (spheres.size ());
+    for (i = 0; i < items.size (); ++i)
+      {
+	sorted.push_back (spheres.getX (items[i]), spheres.getY (items[i]),
+			  spheres.getZ (items[i]), spheres.getRadius (items[i]));
+      }
+  }
+
+
+  void
+  ResidueGrid::neighbors (unsigned int i, vector< unsigned int > &out) const
+  {
+    unsigned int r = rank[i];
+    float px = sorted.getX (r);
+    float py = sorted.getY (r);
+    float pz = sorted.getZ (r);
+    float pr = sorted.getRadius (r);
+    int cx = cellCoord (px, minX, nx);
+    int cy = cellCoord (py, minY, ny);
+    int cz = cellCoord (pz, minZ, nz);
+    int x0 = std::max (0, cx - range);
+    int x1 = std::min (nx - 1, cx + range);
+    int y, z;
+
+    for (z = std::max (0, cz - range); z <= std::min (nz - 1, cz + range); ++z)
+      {
+	for (y = std::max (0, cy - range); y <= std::min (ny - 1, cy + range); ++y)
+	  {
+	    unsigned int row = (z * ny + y) * nx;
+	    unsigned int first = cellStart[row + x0];
+	    unsigned int last = cellStart[row + x1 + 1];
+	    unsigned int base = out.size ();
+	    unsigned int nb;
+	    unsigned int k;
+
+	    if (first == last)
+	      {
+		continue;
+	      }
+	    out.resize (base + last - first);
+	    nb = sorted.near (px, py, pz, pr, cutoff, first, last, &out[base]);
+	    out.resize (base + nb);
+	    for (k = base; k < out.size (); )
+	      {
+		if (out[k] == r)
+		  {
+		    out.erase (out.begin () + k);
+		  }
+		else
+		  {
+		    out[k] = items[out[k]];
+		    ++k;
+		  }
+	      }
+	  }
+      }
+  }
+  
+
+  void
+  ResidueGrid::candidates (vector< pair< unsigned int, unsigned int > > &pairs) const
+  {
+    vector< unsigned int > nbors;
+    vector< unsigned int >::iterator nIt;
+    unsigned int i;
+
+    for (i = 0; i < items.size (); ++i)
+      {
+	nbors.clear ();
+	neighbors (i, nbors);
+	std::sort (nbors.begin (), nbors.end ());
+	for (nIt = std::upper_bound (nbors.begin (), nbors.end (), i);
+	     nbors.end () != nIt;
+	     ++nIt)
+	  {
+	    pairs.push_back (make_pair (i, *nIt));
+	  }
+      }
+  }
+  
+}
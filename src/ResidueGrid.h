@@ -0,0 +1,144 @@
+//                              -*- Mode: C++ -*-
+// ResidueGrid.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Tue Mar 22 14:05:18 2011
+
+
+#ifndef _annotate_ResidueGrid_h_
+#define _annotate_ResidueGrid_h_
+
+#include <utility>
+#include <vector>
+
+#include "SphereTable.h"
+
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Uniform grid index over residue bounding spheres.
+   *
+   * The spheres are bucketed by the cell holding their center.  Two spheres
+   * are candidates when the distance between their surfaces is at most the
+   * interaction cutoff, so every residue pair with atoms closer than the
+   * cutoff is reported.  With the default cell size, twice the largest
+   * radius plus the cutoff, only the 27 cells around a center are visited.
+   * Cell sizes so small that the grid would hold many more cells than
+   * spheres are doubled until it does not.
+   *
+   * The spheres are copied in cell order, so the cells of a grid row are
+   * contiguous and are tested in one SphereTable::near batch.
+   */
+  class ResidueGrid
+  {
+    /**
+     * The interaction cutoff between sphere surfaces.
+     */
+    float cutoff;
+
+    /**
+     * The requested cell edge length, 0 for automatic.
+     */
+    float cellSize;
+
+    /**
+     * The cell edge length in use.
+     */
+    float edge;
+
+    /**
+     * The lower corner of the grid.
+     */
+    float minX, minY, minZ;
+
+    /**
+     * The grid dimensions in cells.
+     */
+    int nx, ny, nz;
+
+    /**
+     * The number of cells to visit on each side of a center's cell.
+     */
+    int range;
+
+    /**
+     * The spheres in cell order.
+     */
+    SphereTable sorted;
+
+    /**
+     * The index of the first sphere of each cell in sorted, plus a
+     * sentinel.
+     */
+    vector< unsigned int > cellStart;
+
+    /**
+     * The original index of each sphere of sorted.
+     */
+    vector< unsigned int > items;
+
+    /**
+     * The position of each original sphere in sorted.
+     */
+    vector< unsigned int > rank;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    /**
+     * Initializes the object.
+     * @param cut the interaction cutoff.
+     * @param size the cell edge length, 0 for automatic.
+     */
+    ResidueGrid (float cut, float size = 0);
+
+    ~ResidueGrid () { }
+
+    // ACCESS ---------------------------------------------------------------
+
+    float getCellSize () const { return edge; }
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Indexes the spheres, replacing the previous content.
+     * @param spheres the spheres.
+     */
+    void build (const SphereTable &spheres);
+
+    /**
+     * Collects every candidate pair (i, j) with i < j.
+     * @param pairs the pairs are appended here.
+     */
+    void candidates (vector< pair< unsigned int, unsigned int > > &pairs) const;
+
+    /**
+     * Collects the candidates of one sphere.
+     * @param i the sphere index.
+     * @param out the indexes of the spheres near i are appended here.
+     */
+    void neighbors (unsigned int i, vector< unsigned int > &out) const;
+
+  private:
+
+    /**
+     * Gets the cell coordinate of a position along one axis.
+     */
+    int cellCoord (float v, float min, int n) const
+    {
+      int c = (int) ((v - min) / edge);
+
+      return c < 0 ? 0 : (c < n ? c : n - 1);
+    }
+    
+  };
+  
+}
+
+#endif
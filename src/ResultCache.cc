@@ -0,0 +1,376 @@
+//                              -*- Mode: C++ -*-
+// ResultCache.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Thu Apr 14 14:26:37 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <vector>
+
+#include <dirent.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <utime.h>
+
+#include "ResultCache.h"
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Incremental 128 bits MurmurHash3 (x64 variant).
+   *
+   * The words are read in little endian order whatever the host, so a key
+   * does not depend on the machine that computed it.
+   */
+  class ContentHash
+  {
+    uint64_t h1;
+    uint64_t h2;
+    unsigned char tail[16];
+    unsigned int tailSize;
+    uint64_t length;
+
+    static const uint64_t C1 = 0x87c37b91114253d5ULL;
+    static const uint64_t C2 = 0x4cf5ad432745937fULL;
+
+  public:
+
+    ContentHash ()
+      : h1 (0), h2 (0), tailSize (0), length (0)
+    { }
+
+    /**
+     * Hashes more bytes.
+     */
+    void update (const void *data, unsigned long n)
+    {
+      const unsigned char *p = (const unsigned char*) data;
+
+      length += n;
+      if (0 != tailSize)
+	{
+	  for (; 0 != n && 16 != tailSize; --n)
+	    {
+	      tail[tailSize++] = *p++;
+	    }
+	  if (16 != tailSize)
+	    {
+	      return;
+	    }
+	  block (tail);
+	  tailSize = 0;
+	}
+      for (; 16 <= n; n -= 16, p += 16)
+	{
+	  block (p);
+	}
+      for (; 0 != n; --n)
+	{
+	  tail[tailSize++] = *p++;
+	}
+    }
+
+    /**
+     * Ends the hash.
+     * @return the hash in hexadecimal.
+     */
+    string getDigest ()
+    {
+      static const char hex[] = "0123456789abcdef";
+      uint64_t k1 = 0;
+      uint64_t k2 = 0;
+      uint64_t words[2];
+      string digest;
+      int i;
+
+      for (i = (int) tailSize - 1; 8 <= i; --i)
+	{
+	  k2 = k2 << 8 | tail[i];
+	}
+      for (; 0 <= i; --i)
+	{
+	  k1 = k1 << 8 | tail[i];
+	}
+      if (8 < tailSize)
+	{
+	  h2 ^= rotl (k2 * C2, 33) * C1;
+	}
+      if (0 < tailSize)
+	{
+	  h1 ^= rotl (k1 * C1, 31) * C2;
+	}
+      h1 ^= length;
+      h2 ^= length;
+      h1 += h2;
+      h2 += h1;
+      h1 = fmix (h1);
+      h2 = fmix (h2);
+      h1 += h2;
+      h2 += h1;
+
+      words[0] = h1;
+      words[1] = h2;
+      for (i = 0; i < 2; ++i)
+	{
+	  int shift;
+
+	  for (shift = 60; 0 <= shift; shift -= 4)
+	    {
+	      digest.push_back (hex[(words[i] >> shift) & 0xf]);
+	    }
+	}
+      return digest;
+    }
+
+  private:
+
+    static uint64_t rotl (uint64_t x, int r)
+    {
+      return x << r | x >> (64 - r);
+    }
+
+    static uint64_t fmix (uint64_t k)
+    {
+      k ^= k >> 33;
+      k *= 0xff51afd7ed558ccdULL;
+      k ^= k >> 33;
+      k *= 0xc4ceb9fe1a85ec53ULL;
+      k ^= k >> 33;
+      return k;
+    }
+
+    static uint64_t load (const unsigned char *p)
+    {
+      uint64_t w = 0;
+      int i;
+
+      for (i = 7; 0 <= i; --i)
+	{
+	  w = w << 8 | p[i];
+	}
+      return w;
+    }
+
+    void block (const unsigned char *p)
+    {
+      h1 ^= rotl (load (p) * C1, 31) * C2;
+      h1 = (rotl (h1, 27) + h2) * 5 + 0x52dce729;
+      h2 ^= rotl (load (p + 8) * C2, 33) * C1;
+      h2 = (rotl (h2, 31) + h1) * 5 + 0x38495ab5;
+    }
+
+  };
+
+
+  /**
+   * An entry seen by prune.
+   */
+  struct CacheEntry
+  {
+    time_t time;
+    unsigned long long size;
+    string path;
+
+    bool operator< (const CacheEntry &right) const
+    {
+      return time < right.time;
+    }
+  };
+
+
+  ResultCache::ResultCache (const string &dir)
+    : directory (dir)
+  {
+    mkdir (directory.c_str (), 0777);
+  }
+
+
+  bool
+  ResultCache::makeKey (const string &filename, const string &options, string &key)
+  {
+    ifstream in (filename.c_str (), ios::in | ios::binary);
+    vector< char > buffer (1 << 16);
+    ContentHash hash;
+    uint64_t length = 0;
+    unsigned char bytes[8];
+    unsigned int i;
+
+    if (in.fail ())
+      {
+	return false;
+      }
+    while (in.read (&buffer[0], buffer.size ()), 0 < in.gcount ())
+      {
+	hash.update (&buffer[0], in.gcount ());
+	length += in.gcount ();
+      }
+    if (in.bad ())
+      {
+	return false;
+      }
+    // The file length, in a fixed width, separates the bytes from the
+    // options: no two (file, options) pairs hash the same input.
+    for (i = 0; i < sizeof (bytes); ++i)
+      {
+	bytes[i] = (unsigned char) (length >> (8 * i));
+      }
+    hash.update (bytes, sizeof (bytes));
+    hash.update (options.data (), options.size ());
+    key = hash.getDigest ();
+    return true;
+  }
+
+
+  bool
+  ResultCache::fetch (const string &key, ostream &os) const
+  {
+    string path = getPath (key);
+    ifstream in (path.c_str (), ios::in | ios::binary);
+    vector< char > buffer (1 << 16);
+
+    if (in.fail ())
+      {
+	return false;
+      }
+    // The entry stays readable if it is evicted meanwhile.
+    utime (path.c_str (), 0);
+    while (in.read (&buffer[0], buffer.size ()), 0 < in.gcount ())
+      {
+	os.write (&buffer[0], in.gcount ());
+      }
+    return true;
+  }
+
+
+  bool
+  ResultCache::store (const string &key, const string &data) const
+  {
+    string sub = getSubdirectory (key);
+    string tmpl = sub + "/.tmpXXXXXX";
+    vector< char > name (tmpl.begin (), tmpl.end ());
+    const char *p;
+    unsigned long left;
+    int fd;
+
+    if (0 != mkdir (sub.c_str (), 0777) && EEXIST != errno)
+      {
+	return false;
+      }
+    name.push_back ('\0');
+    if (0 > (fd = mkstemp (&name[0])))
+      {
+	return false;
+      }
+    for (p = data.data (), left = data.size (); 0 != left; )
+      {
+	ssize_t n = write (fd, p, left);
+
+	if (0 > n)
+	  {
+	    if (EINTR == errno)
+	      {
+		continue;
+	      }
+	    break;
+	  }
+	p += n;
+	left -= n;
+      }
+    fchmod (fd, 0644);
+    if (0 != close (fd) || 0 != left
+	|| 0 != rename (&name[0], getPath (key).c_str ()))
+      {
+	unlink (&name[0]);
+	return false;
+      }
+    return true;
+  }
+
+
+  unsigned int
+  ResultCache::prune (unsigned long long limit) const
+  {
+    vector< CacheEntry > entries;
+    vector< CacheEntry >::iterator it;
+    unsigned long long total = 0;
+    unsigned int removed = 0;
+    DIR *top;
+    struct dirent *sde;
+
+    if (0 == (top = opendir (directory.c_str ())))
+      {
+	return 0;
+      }
+    while (0 != (sde = readdir (top)))
+      {
+	string sub = directory + "/" + sde->d_name;
+	DIR *dir;
+	struct dirent *de;
+
+	if ('.' == sde->d_name[0] || 0 == (dir = opendir (sub.c_str ())))
+	  {
+	    continue;
+	  }
+	while (0 != (de = readdir (dir)))
+	  {
+	    CacheEntry e;
+	    struct stat st;
+
+	    // The temporary files belong to running stores.
+	    if ('.' == de->d_name[0])
+	      {
+		continue;
+	      }
+	    e.path = sub + "/" + de->d_name;
+	    if (0 == stat (e.path.c_str (), &st) && S_ISREG (st.st_mode))
+	      {
+		e.time = st.st_mtime;
+		e.size = st.st_size;
+		total += e.size;
+		entries.push_back (e);
+	      }
+	  }
+	closedir (dir);
+      }
+    closedir (top);
+
+    std::sort (entries.begin (), entries.end ());
+    for (it = entries.begin (); entries.end () != it && limit < total; ++it)
+      {
+	if (0 == unlink (it->path.c_str ()))
+	  {
+	    ++removed;
+	  }
+	total -= it->size;
+      }
+    return removed;
+  }
+
+
+  string
+  ResultCache::getSubdirectory (const string &key) const
+  {
+    return directory + "/" + key.substr (0, 2);
+  }
+
+
+  string
+  ResultCache::getPath (const string &key) const
+  {
+    return getSubdirectory (key) + "/" + key.substr (2);
+  }
+
+}
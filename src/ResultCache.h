@@ -0,0 +1,116 @@
+//                              -*- Mode: C++ -*-
+// ResultCache.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Thu Apr 14 14:26:37 2011
+
+
+#ifndef _annotate_ResultCache_h_
+#define _annotate_ResultCache_h_
+
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short On-disk cache of the outputs of mcannotate, keyed by content.
+   *
+   * The key of an entry is a 128 bits hash of the input file bytes and of
+   * a text describing every option that changes the output.  An entry is
+   * the complete standard output of the file, stored under
+   * directory/xx/yyyy... where xxyyyy... is the key in hexadecimal.
+   *
+   * Entries are written to a temporary file of the same directory then
+   * renamed, so concurrent processes sharing a directory never read a
+   * partial entry.  A hit updates the modification time of the entry, and
+   * prune evicts the entries in modification time order.
+   */
+  class ResultCache
+  {
+    /**
+     * The cache directory.
+     */
+    string directory;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    /**
+     * Initializes the object.
+     * @param dir the cache directory, created when missing.
+     */
+    ResultCache (const string &dir);
+
+    ~ResultCache () { }
+
+  private:
+
+    ResultCache (const ResultCache &right);
+
+    ResultCache& operator= (const ResultCache &right);
+
+  public:
+
+    // ACCESS ---------------------------------------------------------------
+
+    const string& getDirectory () const { return directory; }
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Computes the key of an input file.
+     * @param filename the input file name.
+     * @param options the text of the options changing the output.
+     * @param key the key in hexadecimal (output).
+     * @return false if the file cannot be read.
+     */
+    static bool makeKey (const string &filename, const string &options, string &key);
+
+    /**
+     * Writes a cached output to a stream.
+     * @param key the entry key.
+     * @param os the output stream.
+     * @return false if the entry is not in the cache.
+     */
+    bool fetch (const string &key, ostream &os) const;
+
+    /**
+     * Stores an output.  An error leaves the cache unchanged.
+     * @param key the entry key.
+     * @param data the output.
+     * @return false if the entry could not be written.
+     */
+    bool store (const string &key, const string &data) const;
+
+    /**
+     * Removes the least recently used entries until the entries take at
+     * most the given size.
+     * @param limit the size limit in bytes.
+     * @return the number of removed entries.
+     */
+    unsigned int prune (unsigned long long limit) const;
+
+  private:
+
+    /**
+     * Gets the path of the entry subdirectory of a key.
+     */
+    string getSubdirectory (const string &key) const;
+
+    /**
+     * Gets the path of an entry.
+     */
+    string getPath (const string &key) const;
+
+  };
+
+}
+
+#endif
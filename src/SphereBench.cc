@@ -0,0 +1,161 @@
+//                              -*- Mode: C++ -*-
+// SphereBench.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Mar 28 16:12:07 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include <sys/time.h>
+
+#include "SphereTable.h"
+
+using namespace std;
+using namespace annotate;
+
+
+
+/**
+ * Microbenchmark of the sphere prefilter (the sphere-bench target, built
+ * with the SPHERE_BENCH cmake option).  It fills a table with the bounding
+ * spheres of a random compact model, then tests every pair of spheres
+ * with SphereTable::near, vectorized as the build allows, and with
+ * SphereTable::nearScalar.  Build with NATIVE_BUILD to get the AVX kernel,
+ * the SSE kernel being the x86-64 baseline.
+ *
+ * usage: sphere-bench [residues [rounds]]
+ */
+
+/**
+ * The distance cutoff between surfaces, in angstroms.
+ */
+static const float CUTOFF = 5.0;
+
+/**
+ * The volume of a residue in a compact model, in cubic angstroms.
+ */
+static const float RESIDUE_VOLUME = 300.0;
+
+
+/**
+ * A linear congruential generator, so that every run tests the same model.
+ */
+static unsigned int seed = 12345;
+
+static float
+uniform ()
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 8) / (float) (1 << 24);
+}
+
+
+static double
+now ()
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+
+/**
+ * Tests every pair of spheres of the table once.
+ * @param table the spheres.
+ * @param vectorized whether to use near or nearScalar.
+ * @param out the index buffer, with room for the table size.
+ * @return the number of pairs found.
+ */
+static unsigned long
+allPairs (const SphereTable &table, bool vectorized, vector< unsigned int > &out)
+{
+  unsigned long nb = 0;
+  unsigned int i;
+
+  for (i = 0; i < table.size (); ++i)
+    {
+      float x = table.getX (i);
+      float y = table.getY (i);
+      float z = table.getZ (i);
+      float r = table.getRadius (i);
+
+      nb += (vectorized
+	     ? table.near (x, y, z, r, CUTOFF, i + 1, table.size (), &out[0])
+	     : table.nearScalar (x, y, z, r, CUTOFF, i + 1, table.size (), &out[0]));
+    }
+  return nb;
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  unsigned int nbResidues = 1 < argc ? atoi (argv[1]) : 10000;
+  unsigned int nbRounds = 2 < argc ? atoi (argv[2]) : 5;
+  SphereTable table;
+  vector< unsigned int > out (nbResidues);
+  unsigned long found[2] = { 0, 0 };
+  double best[2] = { 0, 0 };
+  float side;
+  unsigned int round;
+  unsigned int i;
+
+  if (0 == nbResidues || 0 == nbRounds)
+    {
+      cerr << "usage: sphere-bench [residues [rounds]]" << endl;
+      return EXIT_FAILURE;
+    }
+  // A cube at the density of a folded model, the radii of nucleotides.
+  for (side = 1; side * side * side < nbResidues * RESIDUE_VOLUME; side += 1)
+    ;
+  table.reserve (nbResidues);
+  for (i = 0; i < nbResidues; ++i)
+    {
+      table.push_back (side * uniform (), side * uniform (), side * uniform (),
+		       5.0 + 2.0 * uniform ());
+    }
+
+  for (round = 0; round < nbRounds; ++round)
+    {
+      unsigned int k;
+
+      for (k = 0; k < 2; ++k)
+	{
+	  double start = now ();
+	  double elapsed;
+
+	  found[k] = allPairs (table, 0 == k, out);
+	  elapsed = now () - start;
+	  if (0 == round || elapsed < best[k])
+	    {
+	      best[k] = elapsed;
+	    }
+	}
+    }
+
+#if defined (__AVX__)
+  cout << "kernel avx";
+#elif defined (__SSE2__)
+  cout << "kernel sse";
+#else
+  cout << "kernel scalar";
+#endif
+  cout << ", " << nbResidues << " residues, " << found[0] << " pairs within "
+       << CUTOFF << " A" << endl
+       << "near       " << best[0] << " s" << endl
+       << "nearScalar " << best[1] << " s" << endl;
+  if (found[0] != found[1])
+    {
+      cerr << "sphere-bench: the kernels disagree, " << found[0] << " and "
+	   << found[1] << " pairs." << endl;
+      return EXIT_FAILURE;
+    }
+  return EXIT_SUCCESS;
+}
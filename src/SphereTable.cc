@@ -0,0 +1,129 @@
+//                              -*- Mode: C++ -*-
+// SphereTable.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Mar 28 09:41:55 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#if defined (__AVX__) || defined (__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "SphereTable.h"
+
+
+
+namespace annotate
+{
+
+  void
+  SphereTable::clear ()
+  {
+    xs.clear ();
+    ys.clear ();
+    zs.clear ();
+    radii.clear ();
+  }
+
+
+  void
+  SphereTable::reserve (unsigned int n)
+  {
+    xs.reserve (n);
+    ys.reserve (n);
+    zs.reserve (n);
+    radii.reserve (n);
+  }
+
+
+  unsigned int
+  SphereTable::nearScalar (float x, float y, float z, float radius, float cutoff,
+			   unsigned int first, unsigned int last,
+			   unsigned int *out) const
+  {
+    float reach = radius + cutoff;
+    unsigned int nb = 0;
+    unsigned int i;
+
+    for (i = first; i < last; ++i)
+      {
+	float dx = xs[i] - x;
+	float dy = ys[i] - y;
+	float dz = zs[i] - z;
+	float d = radii[i] + reach;
+
+	if (dx * dx + dy * dy + dz * dz <= d * d)
+	  {
+	    out[nb++] = i;
+	  }
+      }
+    return nb;
+  }
+
+  
+  unsigned int
+  SphereTable::near (float x, float y, float z, float radius, float cutoff,
+		     unsigned int first, unsigned int last,
+		     unsigned int *out) const
+  {
+    unsigned int nb = 0;
+    unsigned int i = first;
+
+#if defined (__AVX__)
+    {
+      __m256 px = _mm256_set1_ps (x);
+      __m256 py = _mm256_set1_ps (y);
+      __m256 pz = _mm256_set1_ps (z);
+      __m256 pr = _mm256_set1_ps (radius + cutoff);
+      
+      for (; i + 8 <= last; i += 8)
+	{
+	  __m256 dx = _mm256_sub_ps (_mm256_loadu_ps (&xs[i]), px);
+	  __m256 dy = _mm256_sub_ps (_mm256_loadu_ps (&ys[i]), py);
+	  __m256 dz = _mm256_sub_ps (_mm256_loadu_ps (&zs[i]), pz);
+	  __m256 d = _mm256_add_ps (_mm256_loadu_ps (&radii[i]), pr);
+	  __m256 d2 = _mm256_add_ps (_mm256_add_ps (_mm256_mul_ps (dx, dx),
+						    _mm256_mul_ps (dy, dy)),
+				     _mm256_mul_ps (dz, dz));
+	  int mask = _mm256_movemask_ps (_mm256_cmp_ps (d2, _mm256_mul_ps (d, d), _CMP_LE_OQ));
+
+	  while (0 != mask)
+	    {
+	      out[nb++] = i + __builtin_ctz (mask);
+	      mask &= mask - 1;
+	    }
+	}
+    }
+#elif defined (__SSE2__)
+    {
+      __m128 px = _mm_set1_ps (x);
+      __m128 py = _mm_set1_ps (y);
+      __m128 pz = _mm_set1_ps (z);
+      __m128 pr = _mm_set1_ps (radius + cutoff);
+      
+      for (; i + 4 <= last; i += 4)
+	{
+	  __m128 dx = _mm_sub_ps (_mm_loadu_ps (&xs[i]), px);
+	  __m128 dy = _mm_sub_ps (_mm_loadu_ps (&ys[i]), py);
+	  __m128 dz = _mm_sub_ps (_mm_loadu_ps (&zs[i]), pz);
+	  __m128 d = _mm_add_ps (_mm_loadu_ps (&radii[i]), pr);
+	  __m128 d2 = _mm_add_ps (_mm_add_ps (_mm_mul_ps (dx, dx),
+					      _mm_mul_ps (dy, dy)),
+				  _mm_mul_ps (dz, dz));
+	  int mask = _mm_movemask_ps (_mm_cmple_ps (d2, _mm_mul_ps (d, d)));
+
+	  while (0 != mask)
+	    {
+	      out[nb++] = i + __builtin_ctz (mask);
+	      mask &= mask - 1;
+	    }
+	}
+    }
+#endif
+    return nb + nearScalar (x, y, z, radius, cutoff, i, last, out + nb);
+  }
+  
+}
@@ -0,0 +1,104 @@
+//                              -*- Mode: C++ -*-
+// SphereTable.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Mar 28 09:41:55 2011
+
+
+#ifndef _annotate_SphereTable_h_
+#define _annotate_SphereTable_h_
+
+#include <vector>
+
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Packed structure of arrays of residue bounding spheres.
+   *
+   * The centers and radii are stored in separate float arrays so the
+   * distance prefilter can test several spheres per instruction.  The
+   * kernel uses AVX or SSE when the compiler targets them and falls back to
+   * scalar code otherwise; all variants evaluate the same expression.
+   */
+  class SphereTable
+  {
+    vector< float > xs;
+    vector< float > ys;
+    vector< float > zs;
+    vector< float > radii;
+    
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    SphereTable () { }
+
+    ~SphereTable () { }
+
+    // ACCESS ---------------------------------------------------------------
+
+    unsigned int size () const { return radii.size (); }
+
+    bool empty () const { return radii.empty (); }
+
+    float getX (unsigned int i) const { return xs[i]; }
+
+    float getY (unsigned int i) const { return ys[i]; }
+
+    float getZ (unsigned int i) const { return zs[i]; }
+
+    float getRadius (unsigned int i) const { return radii[i]; }
+
+    // METHODS --------------------------------------------------------------
+
+    void clear ();
+
+    void reserve (unsigned int n);
+
+    /**
+     * Appends a sphere.
+     */
+    void push_back (float x, float y, float z, float radius)
+    {
+      xs.push_back (x);
+      ys.push_back (y);
+      zs.push_back (z);
+      radii.push_back (radius);
+    }
+
+    /**
+     * Finds the spheres of the range [first, last[ whose surface is at most
+     * the cutoff away from the probe sphere.
+     * @param x the probe center x.
+     * @param y the probe center y.
+     * @param z the probe center z.
+     * @param radius the probe radius.
+     * @param cutoff the distance cutoff between surfaces.
+     * @param first the first sphere of the batch.
+     * @param last the end of the batch.
+     * @param out the found indexes are written here, it must have room for
+     * last - first values.
+     * @return the number of indexes written.
+     */
+    unsigned int near (float x, float y, float z, float radius, float cutoff,
+		       unsigned int first, unsigned int last,
+		       unsigned int *out) const;
+
+    /**
+     * The portable version of near, used for the batch tails and when no
+     * vector instruction set is available.
+     */
+    unsigned int nearScalar (float x, float y, float z, float radius, float cutoff,
+			     unsigned int first, unsigned int last,
+			     unsigned int *out) const;
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,143 @@
+//                              -*- Mode: C++ -*-
+// TaskPool.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Mar 14 10:12:31 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "TaskPool.h"
+
+
+
+namespace annotate
+{
+
+  static pthread_mutex_t warmMutex = PTHREAD_MUTEX_INITIALIZER;
+
+  static bool warm = false;
+
+  static pthread_mutex_t serialMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+  TaskPool::TaskPool (unsigned int nb)
+    : nbThreads (0 == nb ? 1 : nb),
+      task (0),
+      count (0),
+      next (0)
+  {
+    pthread_mutex_init (&mutex, 0);
+  }
+
+
+  TaskPool::~TaskPool ()
+  {
+    pthread_mutex_destroy (&mutex);
+  }
+
+
+  bool
+  TaskPool::isWarm ()
+  {
+    bool w;
+
+    pthread_mutex_lock (&warmMutex);
+    w = warm;
+    pthread_mutex_unlock (&warmMutex);
+    return w;
+  }
+
+
+  void
+  TaskPool::setWarm ()
+  {
+    pthread_mutex_lock (&warmMutex);
+    warm = true;
+    pthread_mutex_unlock (&warmMutex);
+  }
+
+
+  void
+  TaskPool::run (Task &t, unsigned int nb)
+  {
+    vector< pthread_t > threads;
+    vector< pthread_t >::iterator thIt;
+    unsigned int index;
+
+    task = &t;
+    count = nb;
+    next = 0;
+    // The jobs run one at a time until a job warmed the pools up.
+    while (1 < nbThreads && ! isWarm () && nextJob (index))
+      {
+	task->run (index);
+      }
+    if (1 < nbThreads && 1 < count - next)
+      {
+	threads.resize (std::min (nbThreads, count - next) - 1);
+	for (thIt = threads.begin (); threads.end () != thIt; ++thIt)
+	  {
+	    if (0 != pthread_create (&*thIt, 0, TaskPool::work, this))
+	      {
+		threads.erase (thIt, threads.end ());
+		break;
+	      }
+	  }
+      }
+    // The calling thread also takes jobs, which covers the single
+    // threaded case and a failed thread creation.
+    work (this);
+    for (thIt = threads.begin (); threads.end () != thIt; ++thIt)
+      {
+	pthread_join (*thIt, 0);
+      }
+    task = 0;
+  }
+
+
+  SerialSection::SerialSection ()
+  {
+    pthread_mutex_lock (&serialMutex);
+  }
+
+
+  SerialSection::~SerialSection ()
+  {
+    pthread_mutex_unlock (&serialMutex);
+  }
+
+
+  bool
+  TaskPool::nextJob (unsigned int &index)
+  {
+    bool found;
+
+    pthread_mutex_lock (&mutex);
+    if ((found = next < count))
+      {
+	index = next++;
+      }
+    pthread_mutex_unlock (&mutex);
+    return found;
+  }
+
+
+  void*
+  TaskPool::work (void *pool)
+  {
+    TaskPool *self = (TaskPool*) pool;
+    unsigned int index;
+
+    while (self->nextJob (index))
+      {
+	self->task->run (index);
+      }
+    return 0;
+  }
+
+}
@@ -0,0 +1,186 @@
+//                              -*- Mode: C++ -*-
+// TaskPool.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Mon Mar 14 10:12:31 2011
+
+
+#ifndef _annotate_TaskPool_h_
+#define _annotate_TaskPool_h_
+
+#include <pthread.h>
+
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Unit of work executed by a TaskPool.
+   *
+   * A Task is a family of independent jobs identified by their index.  The
+   * run method is called concurrently from the pool's threads, it must
+   * therefore only write to data owned by the given index.
+   */
+  class Task
+  {
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    virtual ~Task () { }
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Executes the job at the given index.
+     * @param index the job index, in [0, count[.
+     */
+    virtual void run (unsigned int index) = 0;
+
+  };
+
+
+  /**
+   * @short Fixed size pool of worker threads.
+   *
+   * The pool hands out the job indexes of a Task in increasing order to its
+   * threads until all of them are processed.  With one thread the jobs are
+   * run in the calling thread, without any synchronization.
+   *
+   * The jobs call mccore, which has no locks.  Its shared state is the
+   * PropertyType, ResidueType and AtomType registries and the gErr
+   * stream.  The pools rely on the following:
+   * - The predefined types are built during static initialization.  Looking
+   *   one up only reads a registry.
+   * - A registry is written when a name is first parsed, or when a type is
+   *   first used lazily.  Reading pdb, binary and snapshot input may parse
+   *   new names, so the callers hold a SerialSection around it.  The lazy
+   *   first uses inside Residue::finalize and Relation::annotate are
+   *   serialized by the warm-up: until setWarm is called, once the first
+   *   model is annotated, a pool runs its jobs in the calling thread.
+   * - gErr writes to the standard error stream, which is synchronized with
+   *   stdio, so concurrent diagnostics may interleave but do not race.
+   */
+  class TaskPool
+  {
+    /**
+     * The number of worker threads.
+     */
+    unsigned int nbThreads;
+
+    /**
+     * Protects the job dispatch.
+     */
+    pthread_mutex_t mutex;
+
+    /**
+     * The task being executed.
+     */
+    Task *task;
+
+    /**
+     * The number of jobs of the task.
+     */
+    unsigned int count;
+
+    /**
+     * The next job index to hand out.
+     */
+    unsigned int next;
+
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    /**
+     * Initializes the object.
+     * @param nb the number of worker threads (0 is taken as 1).
+     */
+    TaskPool (unsigned int nb);
+
+    /**
+     * Destroys the object.
+     */
+    ~TaskPool ();
+
+  private:
+
+    TaskPool (const TaskPool &right);
+
+    TaskPool& operator= (const TaskPool &right);
+
+  public:
+
+    // ACCESS ---------------------------------------------------------------
+
+    unsigned int getNbThreads () const { return nbThreads; }
+
+    /**
+     * Tells if the pools run their jobs concurrently, see setWarm.
+     */
+    static bool isWarm ();
+
+    /**
+     * Lets the pools run their jobs concurrently.  It is called once a
+     * model was annotated, which made the lazy first uses of mccore.
+     */
+    static void setWarm ();
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Runs every job of the task and returns when they are all completed.
+     * @param t the task.
+     * @param nb the number of jobs.
+     */
+    void run (Task &t, unsigned int nb);
+
+  private:
+
+    /**
+     * Gets the next job index to process.
+     * @param index the job index (output).
+     * @return false when all jobs were handed out.
+     */
+    bool nextJob (unsigned int &index);
+
+    /**
+     * Thread entry point.
+     * @param pool the TaskPool.
+     * @return null.
+     */
+    static void* work (void *pool);
+
+  };
+
+
+  /**
+   * @short Serializes the mccore calls that may register types.
+   *
+   * The process-wide lock is held for the lifetime of the object; it is
+   * taken around the parsing of the input files, see TaskPool.
+   */
+  class SerialSection
+  {
+  public:
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    SerialSection ();
+
+    ~SerialSection ();
+
+  private:
+
+    SerialSection (const SerialSection &right);
+
+    SerialSection& operator= (const SerialSection &right);
+
+  };
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+//                              -*- Mode: C++ -*-
+// TextWriter.cc
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Tue Apr  5 09:41:18 2011
+
+
+// cmake generated defines
+#include <config.h>
+
+#include <cstring>
+#include <sstream>
+
+#include "mccore/stlio.h"
+
+#include "TextWriter.h"
+
+
+
+namespace annotate
+{
+
+  TextWriter::TextWriter (ostream &os)
+    : os (os),
+      buffer (BUFFER_SIZE),
+      used (0)
+  { }
+
+
+  TextWriter::~TextWriter ()
+  {
+    flush ();
+  }
+
+
+  TextWriter&
+  TextWriter::write (const char *str, unsigned int n)
+  {
+    if (BUFFER_SIZE - used < n)
+      {
+	flushBuffer ();
+	if (BUFFER_SIZE < n)
+	  {
+	    os.write (str, n);
+	    return *this;
+	  }
+      }
+    memcpy (&buffer[used], str, n);
+    used += n;
+    return *this;
+  }
+
+
+  TextWriter&
+  TextWriter::put (const char *str)
+  {
+    return write (str, strlen (str));
+  }
+
+
+  TextWriter&
+  TextWriter::put (unsigned long n)
+  {
+    char digits[24];
+    char *p = digits + sizeof (digits);
+
+    do
+      {
+	*--p = '0' + n % 10;
+	n /= 10;
+      }
+    while (0 != n);
+    return write (p, digits + sizeof (digits) - p);
+  }
+
+
+  TextWriter&
+  TextWriter::putQuoted (const string &str)
+  {
+    static const char hex[] = "0123456789abcdef";
+    string::const_iterator it;
+
+    put ('"');
+    for (it = str.begin (); str.end () != it; ++it)
+      {
+	unsigned char c = *it;
+
+	if ('"' == c || '\\' == c)
+	  {
+	    put ('\\').put ((char) c);
+	  }
+	else if (0x20 > c)
+	  {
+	    put ("\\u00").put (hex[c >> 4]).put (hex[c & 0xf]);
+	  }
+	else
+	  {
+	    put ((char) c);
+	  }
+      }
+    return put ('"');
+  }
+
+
+  const string&
+  TextWriter::format (const PropertyType *t)
+  {
+    map< const PropertyType*, string >::iterator it;
+
+    if (labels.end () == (it = labels.find (t)))
+      {
+	ostringstream oss;
+
+	oss << t;
+	it = labels.insert (make_pair (t, oss.str ())).first;
+      }
+    return it->second;
+  }
+
+
+  void
+  TextWriter::flush ()
+  {
+    flushBuffer ();
+    os.flush ();
+  }
+
+
+  void
+  TextWriter::flushBuffer ()
+  {
+    if (0 != used)
+      {
+	os.write (&buffer[0], used);
+	used = 0;
+      }
+  }
+
+}
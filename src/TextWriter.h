@@ -0,0 +1,211 @@
+//                              -*- Mode: C++ -*-
+// TextWriter.h
+// Copyright © 2011 Institut de recherche en immunologie et en cancérologie
+//                  Université de Montréal.
+// Created On       : Tue Apr  5 09:41:18 2011
+
+
+#ifndef _annotate_TextWriter_h_
+#define _annotate_TextWriter_h_
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "mccore/PropertyType.h"
+
+using namespace mccore;
+using namespace std;
+
+
+
+namespace annotate
+{
+
+  /**
+   * @short Buffered text writer for the annotation reports.
+   *
+   * The text is accumulated in a preallocated buffer that is written to the
+   * target stream in large blocks, instead of going through the stream
+   * formatting and flushing at every end of line.  The text of the labels is
+   * formatted once per writer.  The bytes written are the same as with the
+   * stream operators.
+   */
+  class TextWriter
+  {
+    /**
+     * The target stream.
+     */
+    ostream &os;
+
+    /**
+     * The pending text.
+     */
+    vector< char > buffer;
+
+    /**
+     * The number of pending characters in the buffer.
+     */
+    unsigned int used;
+
+    /**
+     * The formatted labels.
+     */
+    map< const PropertyType*, string > labels;
+
+  public:
+
+    /**
+     * The buffer size.
+     */
+    static const unsigned int BUFFER_SIZE = 65536;
+
+    // LIFECYCLE ------------------------------------------------------------
+
+    /**
+     * Initializes the object.
+     * @param os the target stream.
+     */
+    TextWriter (ostream &os);
+
+    /**
+     * Flushes the pending text and destroys the object.
+     */
+    ~TextWriter ();
+
+  private:
+
+    TextWriter (const TextWriter &right);
+
+    TextWriter& operator= (const TextWriter &right);
+
+  public:
+
+    // METHODS --------------------------------------------------------------
+
+    /**
+     * Writes characters.
+     * @param str the characters.
+     * @param n the number of characters.
+     * @return itself.
+     */
+    TextWriter& write (const char *str, unsigned int n);
+
+    /**
+     * Writes a character.
+     * @param c the character.
+     * @return itself.
+     */
+    TextWriter& put (char c)
+    {
+      if (BUFFER_SIZE == used)
+	{
+	  flushBuffer ();
+	}
+      buffer[used++] = c;
+      return *this;
+    }
+
+    /**
+     * Writes a C string.
+     * @param str the string.
+     * @return itself.
+     */
+    TextWriter& put (const char *str);
+
+    /**
+     * Writes a string.
+     * @param str the string.
+     * @return itself.
+     */
+    TextWriter& put (const string &str)
+    {
+      return write (str.data (), str.size ());
+    }
+
+    /**
+     * Writes a string right aligned in a field, like setw does.
+     * @param str the string.
+     * @param width the field width.
+     * @return itself.
+     */
+    TextWriter& putRight (const string &str, unsigned int width)
+    {
+      for (; str.size () < width; --width)
+	{
+	  put (' ');
+	}
+      return put (str);
+    }
+
+    /**
+     * Writes an unsigned number in decimal.
+     * @param n the number.
+     * @return itself.
+     */
+    TextWriter& put (unsigned long n);
+
+    /**
+     * Writes a label as the stream operator would, formatting it on first
+     * use only.
+     * @param t the label.
+     * @return itself.
+     */
+    TextWriter& put (const PropertyType *t)
+    {
+      return put (format (t));
+    }
+
+    /**
+     * Writes a string as a quoted JSON string, escaping the quotes,
+     * backslashes and control characters.
+     * @param str the string.
+     * @return itself.
+     */
+    TextWriter& putQuoted (const string &str);
+
+    /**
+     * Writes a label as a quoted JSON string.
+     * @param t the label.
+     * @return itself.
+     */
+    TextWriter& putQuoted (const PropertyType *t)
+    {
+      return putQuoted (format (t));
+    }
+
+    /**
+     * Ends a line.  The target stream is not flushed.
+     * @return itself.
+     */
+    TextWriter& endl ()
+    {
+      return put ('\n');
+    }
+
+    /**
+     * Writes the pending text and flushes the target stream.
+     */
+    void flush ();
+
+  private:
+
+    /**
+     * Gets the text of a label as the stream operator writes it, formatting
+     * it on first use only.
+     * @param t the label.
+     * @return the label text.
+     */
+    const string& format (const PropertyType *t);
+
+    /**
+     * Writes the pending text to the target stream.
+     */
+    void flushBuffer ();
+
+  };
+
+}
+
+#endif